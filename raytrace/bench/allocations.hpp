@@ -0,0 +1,24 @@
+/**
+ * @file allocations.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef allocations_hpp
+#define allocations_hpp
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * every heap allocation made in this process, counted by the replacement operator new in allocations.cpp. the
+ * replacements live in a translation unit of their own: with them inlined into callers, GCC sees the free inside
+ * operator delete paired with the new expression's allocation and warns (-Wmismatched-new-delete), even though both
+ * sides go through malloc and free
+ *
+ */
+extern std::atomic<uint64_t> heapAllocations;
+
+#endif /* allocations_hpp */
@@ -0,0 +1,434 @@
+/**
+ * @file bench.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "allocations.hpp"
+#include "camera.hpp"
+#include "geometry.hpp"
+#include "material.hpp"
+#include "render.hpp"
+#include "sampling.hpp"
+#include "scene.hpp"
+#include "shadingcache.hpp"
+#include "wavefront.hpp"
+
+#include <benchmark/benchmark.h>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+
+/**
+ * Microbenchmarks for the hot paths of the renderer: each primitive's intersect, closest hit queries and BVH
+ * builds/refits, each material's scatter (with exact and fast math, and with a shading cache), the film's filters and
+ * splats, and end-to-end castRay/render throughput on both sample scenes, along with checks that rendering a tile
+ * makes no heap allocations and that neither fast math nor the shading cache changes the image beyond the noise.
+ * Google Benchmark writes JSON that can be tracked over time with
+ *
+ *   raytrace_bench --benchmark_out=bench.json --benchmark_out_format=json
+ *
+ */
+
+const int kImageSize = 64;
+const int kBounces = 5;
+const int kNumRays = 1024; // power of two, so the benchmarks can cycle through them with a mask
+
+Scene sceneNamed(const std::string& name) {
+    Scene scene;
+    generateScene(name, scene);
+    return scene;
+}
+
+// camera rays through random pixels, which hit a representative mix of whatever is in the scene
+std::vector<Ray> generateCameraRays() {
+    seedRandom(1);
+    Camera camera = generateCamera(kImageSize, kImageSize);
+    std::vector<Ray> rays;
+    for (int i = 0; i < kNumRays; i++) {
+        rays.push_back(camera.generateRay(glm::vec2(randomFloat(), randomFloat())));
+    }
+    return rays;
+}
+
+struct Hit {
+    Ray ray;
+    glm::vec3 point;
+    glm::vec3 normal;
+    bool inside;
+};
+
+// the first kNumRays camera ray hits in the cornell box, as shading points for the material benchmarks
+std::vector<Hit> generateHits() {
+    Scene scene = sceneNamed("cornell");
+    std::vector<Hit> hits;
+    while (hits.size() < kNumRays) {
+        for (const Ray& ray : generateCameraRays()) {
+            Geometry* closestObject = nullptr;
+            float closestIntersection = std::numeric_limits<float>::max();
+            glm::vec3 closestIntersectionPoint;
+            populateClosestIntersection(scene, ray, closestObject, closestIntersection, closestIntersectionPoint);
+            if (closestObject && hits.size() < kNumRays) {
+                glm::vec3 normal = closestObject->normal(closestIntersectionPoint);
+                hits.push_back({ ray, closestIntersectionPoint, normal, glm::dot(ray.direction, normal) > 0 });
+            }
+        }
+    }
+    return hits;
+}
+
+// first object of type GeometryT in the cornell box
+template <typename GeometryT>
+GeometryT* findGeometry(const Scene& scene) {
+    for (Geometry* geometry : scene.geometry) {
+        if (GeometryT* match = dynamic_cast<GeometryT*>(geometry)) {
+            return match;
+        }
+    }
+    return nullptr;
+}
+
+template <typename GeometryT>
+void BM_Intersect(benchmark::State& state) {
+    Scene scene = sceneNamed("cornell");
+    GeometryT* geometry = findGeometry<GeometryT>(scene);
+    std::vector<Ray> rays = generateCameraRays();
+    
+    size_t i = 0;
+    for (auto _ : state) {
+        glm::vec3 intersection;
+        benchmark::DoNotOptimize(geometry->intersect(rays[i++ & (kNumRays - 1)], intersection));
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_TEMPLATE(BM_Intersect, Sphere);
+BENCHMARK_TEMPLATE(BM_Intersect, AxisAlignedPlane);
+BENCHMARK_TEMPLATE(BM_Intersect, Box);
+
+void BM_PopulateClosestIntersection(benchmark::State& state, const std::string& sceneName) {
+    Scene scene = sceneNamed(sceneName);
+    std::vector<Ray> rays = generateCameraRays();
+    
+    size_t i = 0;
+    for (auto _ : state) {
+        Geometry* closestObject = nullptr;
+        float closestIntersection = std::numeric_limits<float>::max();
+        glm::vec3 closestIntersectionPoint;
+        populateClosestIntersection(scene, rays[i++ & (kNumRays - 1)],
+                                    closestObject, closestIntersection, closestIntersectionPoint);
+        benchmark::DoNotOptimize(closestIntersection);
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_PopulateClosestIntersection, cornell, std::string("cornell"));
+BENCHMARK_CAPTURE(BM_PopulateClosestIntersection, balls, std::string("balls"));
+
+// building the BVH from scratch against refitting it after every object has moved, as animations do between frames
+void BM_BVHBuild(benchmark::State& state, const std::string& sceneName) {
+    Scene scene = sceneNamed(sceneName);
+    for (auto _ : state) {
+        scene.bvh.build(scene.geometry);
+        benchmark::DoNotOptimize(scene.bvh.nodes.data());
+    }
+}
+BENCHMARK_CAPTURE(BM_BVHBuild, cornell, std::string("cornell"));
+BENCHMARK_CAPTURE(BM_BVHBuild, balls, std::string("balls"));
+
+void BM_BVHRefit(benchmark::State& state, const std::string& sceneName) {
+    Scene scene = sceneNamed(sceneName);
+    float offset = 1e-3;
+    for (auto _ : state) {
+        for (Geometry* geometry : scene.geometry) {
+            geometry->translate(glm::vec3(offset, 0, 0));
+        }
+        offset = -offset; // back and forth, so the tree never loosens enough to be rebuilt
+        scene.bvh.refit(scene.geometry);
+        benchmark::DoNotOptimize(scene.bvh.nodes.data());
+    }
+}
+BENCHMARK_CAPTURE(BM_BVHRefit, cornell, std::string("cornell"));
+BENCHMARK_CAPTURE(BM_BVHRefit, balls, std::string("balls"));
+
+void BM_Scatter(benchmark::State& state, const Material material, const bool fastMath) {
+    std::vector<Hit> hits = generateHits();
+    seedRandom(2);
+    setFastMath(fastMath);
+    
+    size_t i = 0;
+    for (auto _ : state) {
+        const Hit& hit = hits[i++ & (kNumRays - 1)];
+        ScatterRecord record = scatter(material, hit.ray, hit.point, hit.normal, hit.inside);
+        benchmark::DoNotOptimize(record);
+        if (record.didScatter && record.pdf != 0.0) {
+            benchmark::DoNotOptimize(scatterPDF(material, hit.ray, hit.normal, record.out.direction));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    setFastMath(false);
+}
+BENCHMARK_CAPTURE(BM_Scatter, lambertian, Material(Lambertian(WHITE)), false);
+BENCHMARK_CAPTURE(BM_Scatter, lambertian_fast, Material(Lambertian(WHITE)), true);
+BENCHMARK_CAPTURE(BM_Scatter, lambertian_sphere, Material(Lambertian(WHITE, SamplingMixture { 0.5f, 0.2f })), false);
+BENCHMARK_CAPTURE(BM_Scatter, metal_mirror, Material(Metal(SILVER, 0.0)), false);
+BENCHMARK_CAPTURE(BM_Scatter, metal_rough, Material(Metal(SILVER, 0.3)), false);
+BENCHMARK_CAPTURE(BM_Scatter, metal_rough_fast, Material(Metal(SILVER, 0.3)), true);
+BENCHMARK_CAPTURE(BM_Scatter, dielectric_smooth, Material(Dielectric(1.5)), false);
+BENCHMARK_CAPTURE(BM_Scatter, dielectric_rough, Material(Dielectric(1.5, 0.3)), false);
+BENCHMARK_CAPTURE(BM_Scatter, dielectric_rough_fast, Material(Dielectric(1.5, 0.3)), true);
+
+// Lambertian scatter with its mixture adapted per cell, from a shading cache populated for the cornell box
+void BM_ScatterShadingCache(benchmark::State& state, const Material material) {
+    Scene scene = sceneNamed("cornell");
+    RenderSettings settings;
+    settings.width = kImageSize;
+    settings.height = kImageSize;
+    settings.bounces = kBounces;
+    ShadingCache cache(scene, 0);
+    cache.populate(scene, generateCamera(settings.width, settings.height), settings);
+    std::vector<Hit> hits = generateHits();
+    seedRandom(2);
+    setShadingCache(&cache);
+    
+    size_t i = 0;
+    for (auto _ : state) {
+        const Hit& hit = hits[i++ & (kNumRays - 1)];
+        ScatterRecord record = scatter(material, hit.ray, hit.point, hit.normal, hit.inside);
+        benchmark::DoNotOptimize(record);
+        if (record.didScatter && record.pdf != 0.0) {
+            benchmark::DoNotOptimize(scatterPDF(material, hit.ray, hit.normal, record.out.direction));
+        }
+    }
+    state.SetItemsProcessed(state.iterations());
+    state.counters["cells"] = static_cast<double>(cache.cells.size());
+    setShadingCache(nullptr);
+}
+BENCHMARK_CAPTURE(BM_ScatterShadingCache, lambertian, Material(Lambertian(WHITE)));
+BENCHMARK_CAPTURE(BM_ScatterShadingCache, lambertian_sphere,
+                  Material(Lambertian(WHITE, SamplingMixture { 0.5f, 0.2f })));
+
+// full paths (up to kBounces deep) for single camera rays, i.e. primary rays per second
+void BM_CastRay(benchmark::State& state, const std::string& sceneName) {
+    Scene scene = sceneNamed(sceneName);
+    std::vector<Ray> rays = generateCameraRays();
+    seedRandom(3);
+    
+    size_t i = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(castRay(scene, rays[i++ & (kNumRays - 1)], kBounces));
+    }
+    state.counters["primary_rays_per_second"] = benchmark::Counter(state.iterations(), benchmark::Counter::kIsRate);
+}
+BENCHMARK_CAPTURE(BM_CastRay, cornell, std::string("cornell"));
+BENCHMARK_CAPTURE(BM_CastRay, balls, std::string("balls"));
+
+// one sample weighted into the pixels around it, with each filter at its usual radius
+void BM_FilmAddSample(benchmark::State& state, const FilterType filterType) {
+    Accumulator accumulator;
+    accumulator.reset(kImageSize, kImageSize);
+    const std::vector<Tile> tiles = { Tile(0, 0, kImageSize, kImageSize) };
+    Film film(accumulator, Filter(filterType, 0), tiles);
+    FilmTile filmTile = film.tile(0);
+    seedRandom(5);
+    
+    for (auto _ : state) {
+        const int col = static_cast<int>(randomFloat(0.0f, 1.0f) * kImageSize);
+        const int row = static_cast<int>(randomFloat(0.0f, 1.0f) * kImageSize);
+        filmTile.addSample(col, row, glm::vec2(randomFloat(0.0f, 1.0f), randomFloat(0.0f, 1.0f)), Color(1, 1, 1));
+    }
+    benchmark::DoNotOptimize(accumulator.sum.data());
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_FilmAddSample, box, FilterType::Box);
+BENCHMARK_CAPTURE(BM_FilmAddSample, tent, FilterType::Tent);
+BENCHMARK_CAPTURE(BM_FilmAddSample, gaussian, FilterType::Gaussian);
+BENCHMARK_CAPTURE(BM_FilmAddSample, mitchell, FilterType::Mitchell);
+
+/**
+ * splats from every thread at once into one shared film, all landing in the same 8x8 pixel corner so that threads
+ * would keep colliding if they shared a buffer. splats per second should scale with the threads
+ *
+ */
+Accumulator splatAccumulator;
+std::vector<Tile> splatTiles;
+std::unique_ptr<Film> splatFilm;
+
+void BM_FilmSplat(benchmark::State& state) {
+    if (state.thread_index() == 0) {
+        splatAccumulator.reset(kImageSize, kImageSize);
+        splatTiles = { Tile(0, 0, kImageSize, kImageSize) };
+        splatFilm = std::make_unique<Film>(splatAccumulator, Filter(), splatTiles);
+    }
+    seedRandom(6 + state.thread_index());
+    
+    // the benchmark library lines the threads up before the first iteration, so thread 0 is done setting up by then
+    for (auto _ : state) {
+        splatFilm->splat(glm::vec2(randomFloat(0.0f, 8.0f), randomFloat(0.0f, 8.0f)), Color(1, 1, 1));
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_FilmSplat)->ThreadRange(1, 16)->UseRealTime();
+
+// end-to-end multithreaded render of a small image, reported as samples per second of wall time
+void BM_Render(benchmark::State& state,
+               const std::string& sceneName,
+               const Integrator integrator,
+               const bool fastMath,
+               const bool shadingCache) {
+    Scene scene = sceneNamed(sceneName);
+    RenderSettings settings;
+    settings.width = kImageSize;
+    settings.height = kImageSize;
+    settings.samples = static_cast<int>(state.range(0));
+    settings.bounces = kBounces;
+    settings.integrator = integrator;
+    settings.fastMath = fastMath;
+    settings.shadingCache = shadingCache;
+    Camera camera = generateCamera(settings.width, settings.height);
+    
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(render(scene, camera, settings));
+    }
+    const double samples = static_cast<double>(state.iterations()) * settings.width * settings.height * settings.samples;
+    state.counters["samples_per_second"] = benchmark::Counter(samples, benchmark::Counter::kIsRate);
+}
+BENCHMARK_CAPTURE(BM_Render, cornell_recursive, std::string("cornell"), Integrator::Recursive, false, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, cornell_recursive_fast, std::string("cornell"), Integrator::Recursive, true, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, cornell_recursive_cached, std::string("cornell"), Integrator::Recursive, false, true)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, cornell_wavefront, std::string("cornell"), Integrator::Wavefront, false, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, balls_recursive, std::string("balls"), Integrator::Recursive, false, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, balls_recursive_fast, std::string("balls"), Integrator::Recursive, true, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK_CAPTURE(BM_Render, balls_wavefront, std::string("balls"), Integrator::Wavefront, false, false)
+    ->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+/**
+ * heap allocations made while rendering one tile, once the render thread has warmed up (i.e. its scratch arena has
+ * grown to what a tile needs). this is expected to be zero for both integrators, and the benchmark fails otherwise:
+ * anything else means something in the per-sample path has started allocating again
+ *
+ */
+void BM_TileAllocations(benchmark::State& state, const std::string& sceneName, const Integrator integrator) {
+    Scene scene = sceneNamed(sceneName);
+    RenderSettings settings;
+    settings.width = kImageSize;
+    settings.height = kImageSize;
+    settings.samples = 4;
+    settings.bounces = kBounces;
+    settings.integrator = integrator;
+    Camera camera = generateCamera(settings.width, settings.height);
+    Accumulator accumulator;
+    accumulator.reset(settings.width, settings.height);
+    const std::vector<Tile> tiles = generateTiles(settings);
+    Film film(accumulator, settings.filter, tiles);
+    FilmTile filmTile = film.tile(0);
+    
+    auto renderTile = [&]() {
+        if (integrator == Integrator::Wavefront) {
+            renderTileWavefront(scene, camera, settings, tiles[0], filmTile, nullptr);
+        } else {
+            renderTileRecursive(scene, camera, settings, tiles[0], filmTile, nullptr);
+        }
+    };
+    seedRandom(4);
+    renderTile();
+    
+    uint64_t allocations = 0;
+    for (auto _ : state) {
+        const uint64_t before = heapAllocations;
+        renderTile();
+        allocations += heapAllocations - before;
+    }
+    state.counters["allocations_per_tile"] = static_cast<double>(allocations) / state.iterations();
+    if (allocations > 0) {
+        state.SkipWithError("rendering a tile allocated on the heap");
+    }
+}
+BENCHMARK_CAPTURE(BM_TileAllocations, cornell_recursive, std::string("cornell"), Integrator::Recursive)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TileAllocations, cornell_wavefront, std::string("cornell"), Integrator::Wavefront)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TileAllocations, balls_recursive, std::string("balls"), Integrator::Recursive)
+    ->Unit(benchmark::kMillisecond);
+BENCHMARK_CAPTURE(BM_TileAllocations, balls_wavefront, std::string("balls"), Integrator::Wavefront)
+    ->Unit(benchmark::kMillisecond);
+
+// root mean squared difference between the per pixel means of two renders of the same size
+double rmsDifference(const Accumulator& a, const Accumulator& b) {
+    double sum = 0.0;
+    for (size_t i = 0; i < a.sum.size(); i++) {
+        const Color difference = a.mean(i) - b.mean(i);
+        sum += glm::dot(difference, difference);
+    }
+    return std::sqrt(sum / (3.0 * a.sum.size()));
+}
+
+/**
+ * image difference checks for options that draw different samples from the same image's distributions, and so should
+ * only change the noise. a render with the option off and one seed is compared against renders with another seed, with
+ * the option off and on: the first pair's difference is pure noise, and the option's render should be no further off
+ * than that. the checks fail if it is more than kImageDifferenceTolerance times further, which a biased one would be
+ *
+ */
+const double kImageDifferenceTolerance = 1.1;
+
+void renderImageDifferences(const std::string& sceneName, bool RenderSettings::*option, double& noise,
+                            double& difference) {
+    Scene scene = sceneNamed(sceneName);
+    RenderSettings settings;
+    settings.width = kImageSize;
+    settings.height = kImageSize;
+    settings.samples = 64;
+    settings.bounces = kBounces;
+    Camera camera = generateCamera(settings.width, settings.height);
+    
+    settings.seed = 1;
+    const Accumulator reference = render(scene, camera, settings);
+    settings.seed = 2;
+    const Accumulator off = render(scene, camera, settings);
+    settings.*option = true;
+    const Accumulator on = render(scene, camera, settings);
+    noise = rmsDifference(reference, off);
+    difference = rmsDifference(reference, on);
+}
+
+// fast math (see sampling.hpp) maps random numbers to directions differently
+void BM_FastMathImageDifference(benchmark::State& state, const std::string& sceneName) {
+    double noise = 0.0, difference = 0.0;
+    for (auto _ : state) {
+        renderImageDifferences(sceneName, &RenderSettings::fastMath, noise, difference);
+    }
+    state.counters["rms_exact_vs_exact"] = noise;
+    state.counters["rms_exact_vs_fast"] = difference;
+    if (difference > kImageDifferenceTolerance * noise) {
+        state.SkipWithError("fast math changed the image by more than the noise");
+    }
+}
+// only cornell, since the balls scene (unlit, on a black background) renders black and has no noise to compare against
+BENCHMARK_CAPTURE(BM_FastMathImageDifference, cornell, std::string("cornell"))
+    ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+// the shading cache (see shadingcache.hpp) splits Lambertian samples between strategies differently from cell to cell
+void BM_ShadingCacheImageDifference(benchmark::State& state, const std::string& sceneName) {
+    double noise = 0.0, difference = 0.0;
+    for (auto _ : state) {
+        renderImageDifferences(sceneName, &RenderSettings::shadingCache, noise, difference);
+    }
+    state.counters["rms_uncached_vs_uncached"] = noise;
+    state.counters["rms_uncached_vs_cached"] = difference;
+    if (difference > kImageDifferenceTolerance * noise) {
+        state.SkipWithError("the shading cache changed the image by more than the noise");
+    }
+}
+BENCHMARK_CAPTURE(BM_ShadingCacheImageDifference, cornell, std::string("cornell"))
+    ->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,221 @@
+/**
+ * @file animation.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "animation.hpp"
+
+#include "camera.hpp"
+#include "threadpool.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+// radiance cache cells default to this fraction of the smallest object's box diagonal
+const float kCellsPerObject = 16;
+
+template <typename Keyframe>
+void interpolationWeights(const std::vector<Keyframe>& keyframes, int frame, size_t& before, size_t& after, float& t) {
+    after = 0;
+    while (after < keyframes.size() && keyframes[after].frame < frame) {
+        after++;
+    }
+    if (after == 0 || after == keyframes.size()) {
+        // held constant before the first and after the last keyframe
+        before = after = std::min(after, keyframes.size() - 1);
+        t = 0;
+        return;
+    }
+    before = after - 1;
+    t = static_cast<float>(frame - keyframes[before].frame) / (keyframes[after].frame - keyframes[before].frame);
+}
+
+void Animation::cameraAt(int frame, glm::vec3& lookFrom, glm::vec3& lookAt) const {
+    if (camera.empty()) {
+        lookFrom = glm::vec3(0, 0, 0);
+        lookAt = glm::vec3(0, 0, -1);
+        return;
+    }
+    size_t before, after;
+    float t;
+    interpolationWeights(camera, frame, before, after, t);
+    lookFrom = (1 - t) * camera[before].lookFrom + t * camera[after].lookFrom;
+    lookAt = (1 - t) * camera[before].lookAt + t * camera[after].lookAt;
+}
+
+glm::vec3 Animation::offsetAt(const std::vector<ObjectKeyframe>& keyframes, int frame) {
+    size_t before, after;
+    float t;
+    interpolationWeights(keyframes, frame, before, after, t);
+    return (1 - t) * keyframes[before].offset + t * keyframes[after].offset;
+}
+
+bool readAnimation(const std::string& filename, Animation& animation, std::string& error) {
+    std::ifstream in(filename);
+    if (!in) {
+        error = "could not read " + filename;
+        return false;
+    }
+    
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        std::istringstream tokens(line);
+        std::string kind;
+        if (!(tokens >> kind) || kind[0] == '#') {
+            continue;
+        }
+        if (kind.find('=') != std::string::npos) {
+            // a setting rather than a keyframe, so the "kind" is already the first pair
+            tokens.clear();
+            tokens.str(line);
+            kind.clear();
+        } else if (kind != "camera" && kind != "object") {
+            error = "line " + std::to_string(lineNumber) + ": unknown keyframe kind " + kind;
+            return false;
+        }
+        
+        int frame = -1;
+        int index = -1;
+        CameraKeyframe cameraKeyframe = { 0, glm::vec3(0, 0, 0), glm::vec3(0, 0, -1) };
+        ObjectKeyframe objectKeyframe = { 0, glm::vec3(0, 0, 0) };
+        std::string token;
+        while (tokens >> token) {
+            const size_t equals = token.find('=');
+            const std::string key = token.substr(0, equals);
+            const std::string value = equals == std::string::npos ? "" : token.substr(equals + 1);
+            
+            bool valid = true;
+            try {
+                if (kind.empty() && key == "frames") {
+                    animation.frames = std::stoi(value);
+                    valid = animation.frames > 0;
+                } else if (!kind.empty() && key == "frame") {
+                    frame = std::stoi(value);
+                    valid = frame >= 0;
+                } else if (kind == "camera" && key == "look_from") {
+                    valid = parseVec3(value, cameraKeyframe.lookFrom);
+                } else if (kind == "camera" && key == "look_at") {
+                    valid = parseVec3(value, cameraKeyframe.lookAt);
+                } else if (kind == "object" && key == "index") {
+                    index = std::stoi(value);
+                    valid = index >= 0;
+                } else if (kind == "object" && key == "offset") {
+                    valid = parseVec3(value, objectKeyframe.offset);
+                } else {
+                    error = "line " + std::to_string(lineNumber) + ": unexpected " + token;
+                    return false;
+                }
+            } catch (const std::exception&) {
+                valid = false;
+            }
+            if (!valid) {
+                error = "line " + std::to_string(lineNumber) + ": bad value for " + key + ": " + value;
+                return false;
+            }
+        }
+        
+        if (kind.empty()) {
+            continue;
+        }
+        if (frame < 0 || (kind == "object" && index < 0)) {
+            error = "line " + std::to_string(lineNumber) + ": " + kind + " keyframes need a frame" +
+                    (kind == "object" ? " and an index" : "");
+            return false;
+        }
+        if (kind == "camera") {
+            cameraKeyframe.frame = frame;
+            animation.camera.push_back(cameraKeyframe);
+        } else {
+            objectKeyframe.frame = frame;
+            animation.objects[index].push_back(objectKeyframe);
+        }
+    }
+    
+    auto byFrame = [](const auto& a, const auto& b) { return a.frame < b.frame; };
+    std::stable_sort(animation.camera.begin(), animation.camera.end(), byFrame);
+    for (auto& object : animation.objects) {
+        std::stable_sort(object.second.begin(), object.second.end(), byFrame);
+    }
+    return true;
+}
+
+void renderAnimation(Scene& scene,
+                     const Animation& animation,
+                     const RenderSettings& settings,
+                     bool reuseLighting,
+                     float cellSize,
+                     const std::function<void(int frame, const Accumulator& image)>& onFrame) {
+    if (reuseLighting) {
+        if (cellSize <= 0) {
+            float smallestDiagonal = std::numeric_limits<float>::max();
+            for (Geometry* geometry : scene.geometry) {
+                const Bounds bounds = geometry->bounds();
+                smallestDiagonal = std::min(smallestDiagonal, glm::length(bounds.max - bounds.min));
+            }
+            cellSize = smallestDiagonal / kCellsPerObject;
+        }
+        scene.radianceCache = std::make_shared<RadianceCache>(cellSize, settings.bounces);
+    }
+    
+    // one set of render threads for the whole sequence, rather than starting new ones every frame
+    ThreadPool pool(settings.threads);
+    std::vector<glm::vec3> offsets(scene.geometry.size(), glm::vec3(0, 0, 0));
+    for (int frame = 0; frame < animation.frames; frame++) {
+        bool moved = false;
+        for (const auto& object : animation.objects) {
+            const glm::vec3 offset = Animation::offsetAt(object.second, frame);
+            if (offset == offsets[object.first]) {
+                continue;
+            }
+            Geometry* geometry = scene.geometry[object.first];
+            geometry->translate(offset - offsets[object.first]);
+            offsets[object.first] = offset;
+            moved = true;
+            if (scene.radianceCache) {
+                scene.radianceCache->forget(geometry);
+            }
+        }
+        if (moved && !scene.bvh.empty()) {
+            scene.bvh.refit(scene.geometry);
+        }
+        
+        glm::vec3 lookFrom, lookAt;
+        animation.cameraAt(frame, lookFrom, lookAt);
+        const Camera camera = generateCamera(settings.width, settings.height, lookFrom, lookAt);
+        
+        RenderSettings frameSettings = settings;
+        frameSettings.seed = settings.seed + frame;
+        const Accumulator image = render(scene, camera, frameSettings, nullptr, &pool);
+        if (scene.radianceCache) {
+            scene.radianceCache->endFrame();
+        }
+        onFrame(frame, image);
+    }
+    
+    scene.radianceCache = nullptr;
+}
+
+std::string frameFilename(const std::string& pattern, int frame) {
+    size_t first = pattern.find('#');
+    if (first == std::string::npos) {
+        // no placeholder, so the number goes in front of the extension (or at the end)
+        const size_t extension = pattern.rfind('.');
+        const size_t slash = pattern.rfind('/');
+        if (extension == std::string::npos || (slash != std::string::npos && extension < slash)) {
+            return frameFilename(pattern + "_####", frame);
+        }
+        return frameFilename(pattern.substr(0, extension) + "_####" + pattern.substr(extension), frame);
+    }
+    
+    const size_t last = pattern.find_first_not_of('#', first);
+    const size_t width = (last == std::string::npos ? pattern.size() : last) - first;
+    std::string number = std::to_string(frame);
+    if (number.size() < width) {
+        number.insert(0, width - number.size(), '0');
+    }
+    return pattern.substr(0, first) + number + pattern.substr(first + width);
+}
@@ -0,0 +1,80 @@
+/**
+ * @file animation.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef animation_hpp
+#define animation_hpp
+
+#include "image.hpp"
+#include "render.hpp"
+#include "scene.hpp"
+
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+
+/* ***********************************************************************
+ * Animation
+ * -----------------------------------------------------------------------
+ * A sequence of frames rendered in one process, with the camera and any of
+ * the scene's objects following keyframes. Animation files hold one
+ * keyframe per line, as a kind followed by key=value pairs:
+ *
+ *   frames=48
+ *   camera frame=0 look_from=0,0,0 look_at=0,0,-1
+ *   camera frame=47 look_from=600,0,-1500 look_at=0,0,-1500
+ *   object index=7 frame=0 offset=0,0,0
+ *   object index=7 frame=47 offset=0,300,0
+ *
+ * where object index is the position of the object in Scene::geometry and
+ * offset is how far it has moved from where the scene put it. Positions
+ * are interpolated linearly between keyframes and held before the first and
+ * after the last. Lines starting with # are comments.
+ * *********************************************************************** */
+
+struct CameraKeyframe {
+    int frame;
+    glm::vec3 lookFrom;
+    glm::vec3 lookAt;
+};
+
+struct ObjectKeyframe {
+    int frame;
+    glm::vec3 offset;
+};
+
+struct Animation {
+    int frames = 1;
+    std::vector<CameraKeyframe> camera; // sorted by frame, and defaulting to generateCamera's placement if empty
+    std::map<int, std::vector<ObjectKeyframe>> objects; // by index into the scene's geometry, each sorted by frame
+    
+    void cameraAt(int frame, glm::vec3& lookFrom, glm::vec3& lookAt) const;
+    static glm::vec3 offsetAt(const std::vector<ObjectKeyframe>& keyframes, int frame);
+};
+
+// fills in animation from the file, returning false with a description of the problem in error if it is malformed
+bool readAnimation(const std::string& filename, Animation& animation, std::string& error);
+
+/**
+ * renders every frame of the animation in turn (each with its own seed), handing them to onFrame as they finish.
+ * objects are moved in place, so the scene is left as of the last frame, and the scene's BVH is refit rather than
+ * rebuilt as they go. with reuseLighting, diffuse lighting converged in earlier frames is reused for static objects
+ * (see RadianceCache), with cells of cellSize (or an edge of a sixteenth of the smallest object's box if 0)
+ *
+ */
+void renderAnimation(Scene& scene,
+                     const Animation& animation,
+                     const RenderSettings& settings,
+                     bool reuseLighting,
+                     float cellSize,
+                     const std::function<void(int frame, const Accumulator& image)>& onFrame);
+
+// filename for a frame, given a pattern where a run of #s stands for the zero padded frame number
+std::string frameFilename(const std::string& pattern, int frame);
+
+#endif /* animation_hpp */
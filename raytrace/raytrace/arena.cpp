@@ -0,0 +1,68 @@
+/**
+ * @file arena.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "arena.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+Arena::~Arena() {
+    runDestructors();
+    freeBlocks();
+}
+
+void* Arena::allocate(size_t bytes, size_t alignment) {
+    assert(alignment <= kArenaBlockAlignment && (alignment & (alignment - 1)) == 0);
+    size_t offset = (used + alignment - 1) & ~(alignment - 1);
+    if (blocks.empty() || offset + bytes > blocks.back().size) {
+        const size_t size = std::max(blockSize, bytes);
+        void* data = ::operator new(size, std::align_val_t(kArenaBlockAlignment));
+        usedBefore += used;
+        blocks.push_back({ static_cast<uint8_t*>(data), size });
+        offset = 0;
+    }
+    used = offset + bytes;
+    return blocks.back().data + offset;
+}
+
+void Arena::reset() {
+    runDestructors();
+    if (blocks.size() > 1) {
+        size_t total = 0;
+        for (const Block& block : blocks) {
+            total += block.size;
+        }
+        freeBlocks();
+        blocks.push_back({ static_cast<uint8_t*>(::operator new(total, std::align_val_t(kArenaBlockAlignment))), total });
+    }
+    used = 0;
+    usedBefore = 0;
+}
+
+size_t Arena::bytesUsed() const {
+    return usedBefore + used;
+}
+
+void Arena::runDestructors() {
+    for (Destructor* destructor = destructors; destructor; destructor = destructor->next) {
+        destructor->destroy(destructor->object);
+    }
+    destructors = nullptr;
+}
+
+void Arena::freeBlocks() {
+    for (const Block& block : blocks) {
+        ::operator delete(block.data, std::align_val_t(kArenaBlockAlignment));
+    }
+    blocks.clear();
+}
+
+Arena& scratchArena() {
+    thread_local Arena arena;
+    return arena;
+}
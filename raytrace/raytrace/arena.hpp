@@ -0,0 +1,111 @@
+/**
+ * @file arena.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef arena_hpp
+#define arena_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/* ***********************************************************************
+ * Arenas
+ * -----------------------------------------------------------------------
+ * Bump allocators for memory whose lifetime is a whole phase rather than
+ * one object: everything a scene is built from (which lives until the scene
+ * goes away), and the per-tile scratch buffers of the render loop (which
+ * live until the tile is done). Allocating is a pointer bump within a large
+ * block, addresses never move once handed out, and everything is released
+ * at once, either when the arena is destroyed or when it is reset.
+ *
+ * Objects made with make() get their destructors run (in reverse order) at
+ * that point too, which is what lets scene geometry hold things like a
+ * mapped file. Raw allocations are never destroyed, so they are only for
+ * trivially destructible types.
+ *
+ * An arena is not thread safe. Each render thread has its own scratch
+ * arena (see scratchArena), and a scene's arena is only added to while the
+ * scene is being built.
+ * *********************************************************************** */
+
+// size of an arena's blocks, unless a single allocation needs more than that
+const size_t kArenaBlockSize = 256 * 1024;
+
+// alignment of every block, so that arrays allocated at the start of one start on a cache line
+const size_t kArenaBlockAlignment = 64;
+
+struct Arena {
+    explicit Arena(size_t blockSize = kArenaBlockSize) : blockSize(blockSize) {}
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena();
+    
+    // uninitialized memory, valid until the arena is reset or destroyed
+    void* allocate(size_t bytes, size_t alignment);
+    
+    template <typename T>
+    T* allocateArray(size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "arrays are never destroyed, use make()");
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+    
+    // constructs a T in the arena, which is destroyed along with it
+    template <typename T, typename... Args>
+    T* make(Args&&... args) {
+        if constexpr (std::is_trivially_destructible<T>::value) {
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+        Destructor* destructor = new (allocate(sizeof(Destructor), alignof(Destructor))) Destructor();
+        T* object = new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        destructor->object = object;
+        destructor->destroy = [](void* object) { static_cast<T*>(object)->~T(); };
+        destructor->next = destructors;
+        destructors = destructor;
+        return object;
+    }
+    
+    /**
+     * destroys everything made in the arena and makes all of its memory available again. if that took more than one
+     * block, they are merged into a single one big enough for all of it, so an arena that is reset after every tile
+     * (say) stops allocating once it has seen its largest tile
+     *
+     */
+    void reset();
+    
+    // bytes handed out since the last reset
+    size_t bytesUsed() const;
+    
+    struct Block {
+        uint8_t* data;
+        size_t size;
+    };
+    
+    // objects whose destructors still need to run, most recently made first
+    struct Destructor {
+        void* object;
+        void (*destroy)(void* object);
+        Destructor* next;
+    };
+    
+    const size_t blockSize;
+    std::vector<Block> blocks; // the last one is being allocated from
+    size_t used = 0; // bytes used in the last block
+    size_t usedBefore = 0; // bytes used in all the other blocks
+    Destructor* destructors = nullptr;
+    
+    void runDestructors();
+    void freeBlocks();
+};
+
+// the calling thread's arena for scratch data, which whoever uses it resets once done (e.g. at the end of a tile)
+Arena& scratchArena();
+
+#endif /* arena_hpp */
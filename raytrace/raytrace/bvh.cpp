@@ -0,0 +1,196 @@
+/**
+ * @file bvh.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "bvh.hpp"
+
+#include "stats.hpp"
+
+#include <algorithm>
+
+// nodes with this many primitives or fewer are never split
+const int kMaxLeafPrimitives = 2;
+
+// cost of visiting a node relative to testing a primitive, for the surface area heuristic
+const float kTraversalCost = 0.5;
+
+// refit trees whose boxes have grown past this multiple of their built surface area are rebuilt instead
+const float kRebuildSurfaceAreaRatio = 2.0;
+
+// orders primitives[first, first + count) along axis (ties broken by index, so builds are deterministic)
+void sortByCentroid(BVH& bvh, const std::vector<Bounds>& bounds, int first, int count, int axis) {
+    std::sort(bvh.primitives.begin() + first, bvh.primitives.begin() + first + count, [&bounds, axis](int a, int b) {
+        const float centerA = bounds[a].center()[axis];
+        const float centerB = bounds[b].center()[axis];
+        return centerA < centerB || (centerA == centerB && a < b);
+    });
+}
+
+int buildNode(BVH& bvh, const std::vector<Bounds>& bounds, int first, int count, int depth) {
+    const int index = static_cast<int>(bvh.nodes.size());
+    bvh.nodes.push_back(BVHNode());
+    
+    Bounds nodeBounds, centroidBounds;
+    for (int i = first; i < first + count; i++) {
+        nodeBounds.extend(bounds[bvh.primitives[i]]);
+        centroidBounds.extend(bounds[bvh.primitives[i]].center());
+    }
+    bvh.nodes[index].bounds = nodeBounds;
+    bvh.nodes[index].first = first;
+    bvh.nodes[index].count = count;
+    if (count <= kMaxLeafPrimitives || depth + 1 >= kMaxBVHDepth) {
+        return index;
+    }
+    
+    // try every split between neighbouring centroids along each axis, keeping whichever the surface area heuristic
+    // (the chance of a ray that hits this node hitting each half, times what is in there) rates cheapest. testing
+    // everything in a leaf is the bar to beat
+    float bestCost = count;
+    int bestAxis = -1;
+    int bestSplit = 0;
+    std::vector<float> rightAreas(count);
+    for (int axis = 0; axis < 3; axis++) {
+        if (centroidBounds.min[axis] >= centroidBounds.max[axis]) {
+            continue;
+        }
+        sortByCentroid(bvh, bounds, first, count, axis);
+        
+        Bounds right;
+        for (int split = count - 1; split > 0; split--) {
+            right.extend(bounds[bvh.primitives[first + split]]);
+            rightAreas[split] = right.surfaceArea();
+        }
+        Bounds left;
+        for (int split = 1; split < count; split++) {
+            left.extend(bounds[bvh.primitives[first + split - 1]]);
+            const float cost = kTraversalCost + (left.surfaceArea() * split + rightAreas[split] * (count - split)) /
+                                                nodeBounds.surfaceArea();
+            if (cost < bestCost) {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = split;
+            }
+        }
+    }
+    if (bestAxis < 0) {
+        return index;
+    }
+    
+    sortByCentroid(bvh, bounds, first, count, bestAxis);
+    buildNode(bvh, bounds, first, bestSplit, depth + 1);
+    const int secondChild = buildNode(bvh, bounds, first + bestSplit, count - bestSplit, depth + 1);
+    bvh.nodes[index].secondChild = secondChild;
+    bvh.nodes[index].count = 0;
+    return index;
+}
+
+void BVH::build(const std::vector<Geometry*>& geometry) {
+    std::vector<Bounds> bounds(geometry.size());
+    for (size_t i = 0; i < geometry.size(); i++) {
+        bounds[i] = geometry[i]->bounds();
+    }
+    build(bounds);
+}
+
+void BVH::build(const std::vector<Bounds>& bounds) {
+    nodes.clear();
+    primitives.resize(bounds.size());
+    for (size_t i = 0; i < bounds.size(); i++) {
+        primitives[i] = static_cast<int>(i);
+    }
+    if (bounds.empty()) {
+        return;
+    }
+    
+    buildNode(*this, bounds, 0, static_cast<int>(bounds.size()), 0);
+    builtSurfaceArea = 0;
+    for (const BVHNode& node : nodes) {
+        builtSurfaceArea += node.bounds.surfaceArea();
+    }
+}
+
+bool BVH::refit(const std::vector<Geometry*>& geometry) {
+    float surfaceArea = 0;
+    for (int index = static_cast<int>(nodes.size()) - 1; index >= 0; index--) {
+        BVHNode& node = nodes[index];
+        node.bounds = Bounds();
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                node.bounds.extend(geometry[primitives[i]]->bounds());
+            }
+        } else {
+            node.bounds.extend(nodes[index + 1].bounds);
+            node.bounds.extend(nodes[node.secondChild].bounds);
+        }
+        surfaceArea += node.bounds.surfaceArea();
+    }
+    
+    if (surfaceArea > kRebuildSurfaceAreaRatio * builtSurfaceArea) {
+        build(geometry);
+        return true;
+    }
+    return false;
+}
+
+int BVH::intersect(const std::vector<Geometry*>& geometry,
+                   const Ray& ray,
+                   float& closestIntersection,
+                   glm::vec3& closestIntersectionPoint) const {
+    const glm::vec3 inverseDirection = 1.0f / ray.direction;
+    if (nodes.empty() || nodes[0].bounds.intersect(ray, inverseDirection, closestIntersection) < 0) {
+        return -1;
+    }
+    
+    // nodes still to visit, with the distance at which the ray enters them (so that they can be skipped if a closer
+    // hit turns up in the meantime)
+    int stack[kMaxBVHDepth];
+    float stackDistance[kMaxBVHDepth];
+    int stackSize = 0;
+    
+    int closestPrimitive = -1;
+    int index = 0;
+    while (true) {
+        STATS_COUNT(BVHNodes);
+        const BVHNode& node = nodes[index];
+        if (node.count > 0) {
+            for (int i = node.first; i < node.first + node.count; i++) {
+                glm::vec3 intersectionPoint;
+                float intersection = geometry[primitives[i]]->intersect(ray, intersectionPoint);
+                if (intersection > 0 && intersection < closestIntersection) {
+                    closestIntersection = intersection;
+                    closestIntersectionPoint = intersectionPoint;
+                    closestPrimitive = primitives[i];
+                }
+            }
+        } else {
+            // visit the nearer child first, since its hits let the other one be skipped
+            int near = index + 1;
+            int far = node.secondChild;
+            float nearDistance = nodes[near].bounds.intersect(ray, inverseDirection, closestIntersection);
+            float farDistance = nodes[far].bounds.intersect(ray, inverseDirection, closestIntersection);
+            if (farDistance >= 0 && (nearDistance < 0 || farDistance < nearDistance)) {
+                std::swap(near, far);
+                std::swap(nearDistance, farDistance);
+            }
+            if (nearDistance >= 0) {
+                if (farDistance >= 0) {
+                    stack[stackSize] = far;
+                    stackDistance[stackSize++] = farDistance;
+                }
+                index = near;
+                continue;
+            }
+        }
+        
+        do {
+            if (stackSize == 0) {
+                return closestPrimitive;
+            }
+            index = stack[--stackSize];
+        } while (stackDistance[stackSize] > closestIntersection);
+    }
+}
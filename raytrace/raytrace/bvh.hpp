@@ -0,0 +1,74 @@
+/**
+ * @file bvh.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef bvh_hpp
+#define bvh_hpp
+
+#include "geometry.hpp"
+
+#include <memory>
+#include <vector>
+
+/* ***********************************************************************
+ * Bounding volume hierarchy
+ * -----------------------------------------------------------------------
+ * Binary tree of boxes over a scene's geometry, so that closest hit queries
+ * only test the primitives whose boxes the ray actually passes through
+ * rather than every primitive in the scene. It is built top down, splitting
+ * where the surface area heuristic says a ray is least likely to have to
+ * visit both halves.
+ *
+ * Nodes are stored depth first, so a node's first child directly follows it
+ * and every child comes after its parent. That makes refitting (after
+ * objects move) a single backwards pass that recomputes each box from its
+ * children, keeping the tree's topology. A refit tree stays correct however
+ * far things move, it just gets slower as boxes grow to overlap, so refit()
+ * rebuilds from scratch once the boxes have grown too much.
+ * *********************************************************************** */
+
+// traversal keeps a fixed size stack, so builds stop splitting at this depth
+const int kMaxBVHDepth = 64;
+
+struct BVHNode {
+    Bounds bounds;
+    int secondChild; // the first child is the next node. both are unused in leaves
+    int first, count; // leaves hold primitives[first, first + count), and inner nodes have count == 0
+};
+
+struct BVH {
+    std::vector<BVHNode> nodes;
+    std::vector<int> primitives; // indices into the geometry the tree was built over
+    float builtSurfaceArea = 0; // summed node surface area as of the last build, to judge refits against
+    
+    bool empty() const {
+        return nodes.empty();
+    }
+    
+    // geometry must not be added to or removed from after the build, only moved (followed by a refit)
+    void build(const std::vector<Geometry*>& geometry);
+    
+    // builds over bare boxes instead, e.g. for primitives that are not Geometry objects (see meshpack)
+    void build(const std::vector<Bounds>& bounds);
+    
+    // updates the boxes for geometry that has moved since the tree was built, returning true if that left the tree
+    // so loose that it was rebuilt instead
+    bool refit(const std::vector<Geometry*>& geometry);
+    
+    /**
+     * closest hit along the ray that is nearer than closestIntersection, by the same rule as a linear search over
+     * geometry (the smallest positive distance). returns the index into geometry of what was hit, updating
+     * closestIntersection and closestIntersectionPoint, or -1 if nothing was
+     *
+     */
+    int intersect(const std::vector<Geometry*>& geometry,
+                  const Ray& ray,
+                  float& closestIntersection,
+                  glm::vec3& closestIntersectionPoint) const;
+};
+
+#endif /* bvh_hpp */
@@ -9,15 +9,20 @@
 #ifndef camera_hpp
 #define camera_hpp
 
+#include "sampling.hpp"
 #include "util.hpp"
 
-#include <glm/gtc/random.hpp>
+#include <cmath>
 
-glm::vec2 sampleUnitDisc() {
+inline glm::vec2 sampleUnitDisc() {
+    if (fastMathEnabled()) {
+        float u1 = randomFloat(0.0f, 1.0f);
+        return concentricSampleDisc(u1, randomFloat(0.0f, 1.0f));
+    }
     while (true) {
         glm::vec2 proposal(
-                           2.0 * (glm::linearRand(0.0f, 1.0f) - 0.5),
-                           2.0 * (glm::linearRand(0.0f, 1.0f) - 0.5)
+                           2.0 * (randomFloat(0.0f, 1.0f) - 0.5),
+                           2.0 * (randomFloat(0.0f, 1.0f) - 0.5)
                            );
         if (glm::length(proposal) <= 1.0) {
             return proposal;
@@ -47,7 +52,7 @@ struct Camera {
     }
     
     // produces the ray from the camera center through a particular normalized pixel coordinate
-    Ray generateRay(const glm::vec2& uv) {
+    Ray generateRay(const glm::vec2& uv) const {
         glm::vec2 ccdPosition(uv.x * ccd.x - ccd.x / 2, uv.y * ccd.y - ccd.y / 2);
         glm::vec2 dofOffset(0, 0);
         if (aperture > 0) {
@@ -60,4 +65,21 @@ struct Camera {
     }
 };
 
+// pinhole camera with a 45 degree vertical field of view, sized for a width x height image
+inline Camera generateCamera(int width,
+                             int height,
+                             const glm::vec3& lookFrom = glm::vec3(0, 0, 0),
+                             const glm::vec3& lookAt = glm::vec3(0, 0, -1)) {
+    const float imageAspectRatio = static_cast<float>(width) / height;
+    
+    const float theta = M_PI / 4;
+    float h = tan(theta/2);
+    float cameraCCDheight = 2.0 * h;
+    float cameraCCDwidth = imageAspectRatio * cameraCCDheight;
+    const float focal = 1.0;
+    const float aperture = 0.0;
+    
+    return Camera(lookFrom, glm::vec2(cameraCCDwidth, cameraCCDheight), lookAt, focal, aperture);
+}
+
 #endif /* camera_hpp */
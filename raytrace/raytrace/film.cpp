@@ -0,0 +1,232 @@
+/**
+ * @file film.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "film.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+bool parseFilterType(const std::string& name, FilterType& type) {
+    if (name == "box") {
+        type = FilterType::Box;
+        return true;
+    }
+    if (name == "tent") {
+        type = FilterType::Tent;
+        return true;
+    }
+    if (name == "gaussian") {
+        type = FilterType::Gaussian;
+        return true;
+    }
+    if (name == "mitchell") {
+        type = FilterType::Mitchell;
+        return true;
+    }
+    return false;
+}
+
+// falloff of the Gaussian filter, in 1 / pixels^2 (as in pbrt)
+const float kGaussianAlpha = 2.0f;
+
+// Mitchell and Netravali's B and C, on the B + 2C = 1 line they recommend
+const float kMitchellB = 1.0f / 3;
+const float kMitchellC = 1.0f / 3;
+
+// intervals of the midpoint rule that works out the filters' integrals
+const int kFilterIntegralSteps = 1024;
+
+Filter::Filter(FilterType type, float radius) : type(type), radius(radius) {
+    if (this->radius <= 0) {
+        const float defaultRadius[] = { 0.5f, 1.0f, 1.5f, 2.0f };
+        this->radius = defaultRadius[static_cast<int>(type)];
+    }
+    this->radius = std::min(this->radius, kMaxFilterRadius);
+    
+    // the box's integral is exact, so that a sample in its own pixel weighs exactly 1 by default
+    float integral = 2 * this->radius;
+    if (type != FilterType::Box) {
+        integral = 0;
+        const float step = 2 * this->radius / kFilterIntegralSteps;
+        for (int i = 0; i < kFilterIntegralSteps; i++) {
+            integral += evaluate(-this->radius + (i + 0.5f) * step) * step;
+        }
+    }
+    scale = 1 / (integral * integral);
+}
+
+float Filter::evaluate(float x) const {
+    x = std::fabs(x);
+    if (x >= radius) {
+        return 0;
+    }
+    switch (type) {
+        case FilterType::Box:
+            return 1;
+        case FilterType::Tent:
+            return 1 - x / radius;
+        case FilterType::Gaussian:
+            return std::exp(-kGaussianAlpha * x * x) - std::exp(-kGaussianAlpha * radius * radius);
+        case FilterType::Mitchell: {
+            // the cubic is defined on [-2, 2], stretched to the radius
+            const float t = 2 * x / radius;
+            const float B = kMitchellB, C = kMitchellC;
+            if (t < 1) {
+                return ((12 - 9 * B - 6 * C) * t * t * t + (-18 + 12 * B + 6 * C) * t * t + (6 - 2 * B)) / 6;
+            }
+            return ((-B - 6 * C) * t * t * t + (6 * B + 30 * C) * t * t + (-12 * B - 48 * C) * t +
+                    (8 * B + 24 * C)) / 6;
+        }
+    }
+    return 0;
+}
+
+int Filter::margin() const {
+    return std::max(0, static_cast<int>(std::ceil(radius - 0.5f)));
+}
+
+// the largest float below 1, which offsets are clamped to so that rounding can never push a sample into the next pixel
+const float kOneMinusEpsilon = 0x1.fffffep-1;
+
+/**
+ * a sample at offset within pixel (col, row) is at offset - 0.5 from the pixel's centre, and reaches the pixels x with
+ * centres in [sample - radius, sample + radius), i.e. x in (col + offset - 0.5 - radius, col + offset - 0.5 + radius].
+ * the interval is half open so that with the box filter, the sample's own pixel is the only one
+ *
+ */
+template <typename Add>
+void FilmTile::forEachPixel(int col, int row, const glm::vec2& offset, const Add& add) const {
+    const float radius = filter->radius;
+    const float ox = std::min(offset.x, kOneMinusEpsilon) - 0.5f;
+    const float oy = std::min(offset.y, kOneMinusEpsilon) - 0.5f;
+    const int dx0 = std::max(static_cast<int>(std::floor(ox - radius)) + 1, bounds.x0 - col);
+    const int dx1 = std::min(static_cast<int>(std::floor(ox + radius)), bounds.x1 - 1 - col);
+    const int dy0 = std::max(static_cast<int>(std::floor(oy - radius)) + 1, bounds.y0 - row);
+    const int dy1 = std::min(static_cast<int>(std::floor(oy + radius)), bounds.y1 - 1 - row);
+    
+    // the filter is separable, so each row and column's factor is only evaluated once
+    const int kMaxReach = 2 * static_cast<int>(kMaxFilterRadius) + 2;
+    float columnWeights[kMaxReach];
+    for (int dx = dx0; dx <= dx1; dx++) {
+        columnWeights[dx - dx0] = filter->evaluate(ox - dx);
+    }
+    for (int dy = dy0; dy <= dy1; dy++) {
+        const float rowWeight = filter->scale * filter->evaluate(oy - dy);
+        const int rowStart = (row + dy - bounds.y0) * stride + col - bounds.x0;
+        for (int dx = dx0; dx <= dx1; dx++) {
+            add(rowStart + dx, rowWeight * columnWeights[dx - dx0]);
+        }
+    }
+}
+
+void FilmTile::addSample(int col, int row, const glm::vec2& offset, const Color& radiance) {
+    forEachPixel(col, row, offset, [this, &radiance](int pixel, float pixelWeight) {
+        sum[pixel] += pixelWeight * radiance;
+        weight[pixel] += pixelWeight;
+    });
+}
+
+void FilmTile::addWeight(int col, int row, const glm::vec2& offset) {
+    forEachPixel(col, row, offset, [this](int pixel, float pixelWeight) {
+        weight[pixel] += pixelWeight;
+    });
+}
+
+void FilmTile::addRadiance(int col, int row, const glm::vec2& offset, const Color& radiance) {
+    forEachPixel(col, row, offset, [this, &radiance](int pixel, float pixelWeight) {
+        sum[pixel] += pixelWeight * radiance;
+    });
+}
+
+Film::Film(Accumulator& accumulator, const Filter& filter, const std::vector<Tile>& tiles) :
+    accumulator(accumulator), filter(filter), tiles(tiles) {
+    if (filter.margin() == 0) {
+        return;
+    }
+    size_t size = 0;
+    for (size_t i = 0; i < tiles.size(); i++) {
+        tileOffsets.push_back(size);
+        size += paddedBounds(i).numPixels();
+    }
+    tileSums.assign(size, Color(0, 0, 0));
+    tileWeights.assign(size, 0.0f);
+}
+
+Tile Film::paddedBounds(size_t tileIndex) const {
+    const Tile& tile = tiles[tileIndex];
+    const int margin = filter.margin();
+    return Tile(std::max(tile.x0 - margin, 0), std::max(tile.y0 - margin, 0),
+                std::min(tile.x1 + margin, accumulator.width), std::min(tile.y1 + margin, accumulator.height));
+}
+
+FilmTile Film::tile(size_t tileIndex) {
+    // without a margin, tiles never overlap in the image either, so they can go straight into the accumulator
+    if (tileOffsets.empty()) {
+        const Tile& tile = tiles[tileIndex];
+        const int pixel = tile.y0 * accumulator.width + tile.x0;
+        return { tile, accumulator.width, &accumulator.sum[pixel], &accumulator.weight[pixel], &filter };
+    }
+    const Tile bounds = paddedBounds(tileIndex);
+    const size_t offset = tileOffsets[tileIndex];
+    return { bounds, bounds.x1 - bounds.x0, &tileSums[offset], &tileWeights[offset], &filter };
+}
+
+// splat shard of the calling thread. threads are handed out shards in turn, so up to kNumSplatShards never share one
+int splatShard() {
+    static std::atomic<int> nextShard(0);
+    thread_local int shard = nextShard++ % Film::kNumSplatShards;
+    return shard;
+}
+
+void Film::splat(const glm::vec2& raster, const Color& radiance) {
+    const int col = static_cast<int>(std::floor(raster.x));
+    const int row = static_cast<int>(std::floor(raster.y));
+    if (col < 0 || col >= accumulator.width || row < 0 || row >= accumulator.height) {
+        return;
+    }
+    
+    const size_t numChannels = 3 * accumulator.sum.size();
+    std::call_once(splatsAllocated, [this, numChannels]() {
+        splats.reset(new std::atomic<float>[kNumSplatShards * numChannels]);
+        for (size_t i = 0; i < kNumSplatShards * numChannels; i++) {
+            splats[i].store(0.0f, std::memory_order_relaxed);
+        }
+    });
+    
+    // there is no atomic float add before C++20, so it is a compare and swap loop
+    std::atomic<float>* pixel = &splats[splatShard() * numChannels + 3 * (row * accumulator.width + col)];
+    for (int channel = 0; channel < 3; channel++) {
+        float current = pixel[channel].load(std::memory_order_relaxed);
+        while (!pixel[channel].compare_exchange_weak(current, current + radiance[channel],
+                                                     std::memory_order_relaxed)) {}
+    }
+}
+
+void Film::resolve() {
+    for (size_t tileIndex = 0; tileIndex < tileOffsets.size(); tileIndex++) {
+        const FilmTile buffer = tile(tileIndex);
+        for (int row = buffer.bounds.y0; row < buffer.bounds.y1; row++) {
+            for (int col = buffer.bounds.x0; col < buffer.bounds.x1; col++) {
+                const int pixel = (row - buffer.bounds.y0) * buffer.stride + col - buffer.bounds.x0;
+                accumulator.sum[row * accumulator.width + col] += buffer.sum[pixel];
+                accumulator.weight[row * accumulator.width + col] += buffer.weight[pixel];
+            }
+        }
+    }
+    
+    if (splats) {
+        const size_t numChannels = 3 * accumulator.sum.size();
+        for (int shard = 0; shard < kNumSplatShards; shard++) {
+            for (size_t i = 0; i < accumulator.sum.size(); i++) {
+                for (int channel = 0; channel < 3; channel++) {
+                    accumulator.sum[i][channel] += splats[shard * numChannels + 3 * i + channel].load();
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+/**
+ * @file film.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef film_hpp
+#define film_hpp
+
+#include "image.hpp"
+#include "util.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/* ***********************************************************************
+ * Film
+ * -----------------------------------------------------------------------
+ * Where samples are turned into pixels. Each sample lands at some point
+ * within its pixel, and a reconstruction filter centred on every pixel
+ * decides how much the sample counts towards it: a pixel ends up with the
+ * filter weighted mean of the samples around it. The default box filter
+ * only covers the pixel itself with weight 1, which is the plain per pixel
+ * mean. The wider filters also take in samples from neighbouring pixels,
+ * trading a little sharpness (or, with Mitchell's negative lobes, a little
+ * ringing) for less aliasing and noise.
+ *
+ * Render threads each fill in the buffer of the tile they are rendering,
+ * padded by however far the filter reaches past the tile. The padding of
+ * neighbouring tiles overlaps, so rather than locking, those buffers are
+ * kept apart and only added together (in tile order, so the result does
+ * not depend on which thread got which tile) once the render is done. With
+ * the box filter there is no padding, and tiles write straight into the
+ * output.
+ *
+ * Some estimators (light tracing, say) produce contributions for whichever
+ * pixel a path happens to reach rather than the one its sample came from.
+ * Those are splatted: added atomically into one of a few copies of the image,
+ * picked per thread, so that threads rarely contend for the same pixel.
+ * *********************************************************************** */
+
+// how far out (in pixels) a filter can reach from the centre of a pixel
+const float kMaxFilterRadius = 4.0f;
+
+enum class FilterType {
+    Box,
+    Tent,
+    Gaussian,
+    Mitchell,
+};
+
+bool parseFilterType(const std::string& name, FilterType& type);
+
+/**
+ * separable filter, scaled to integrate to 1 over the plane, so that a pixel's total weight grows by (about) 1 per
+ * sample whichever filter is used. the box filter of radius 0.5 weighs every sample in its pixel exactly 1
+ *
+ */
+struct Filter {
+    FilterType type = FilterType::Box;
+    float radius = 0.5f;
+    float scale = 1.0f;
+    
+    Filter() {}
+    
+    // a radius <= 0 picks the type's usual one: 0.5 for box, 1 for tent, 1.5 for Gaussian and 2 for Mitchell
+    Filter(FilterType type, float radius);
+    
+    // unscaled profile along one axis, at x pixels from the centre
+    float evaluate(float x) const;
+    
+    float weight(float dx, float dy) const {
+        return scale * evaluate(dx) * evaluate(dy);
+    }
+    
+    // how many pixels past its own a sample can reach
+    int margin() const;
+};
+
+// half-open pixel rectangle [x0, x1) x [y0, y1), which is the unit of work handed to render threads
+struct Tile {
+    int x0, y0, x1, y1;
+    
+    Tile(int x0, int y0, int x1, int y1) : x0(x0), y0(y0), x1(x1), y1(y1) {}
+    
+    int numPixels() const {
+        return (x1 - x0) * (y1 - y0);
+    }
+};
+
+/**
+ * one render thread's view of the film while it renders a tile: the filtered sums and weights of the pixels in
+ * bounds (the tile plus the filter's margin, clipped to the image), row major with the given stride
+ *
+ */
+struct FilmTile {
+    Tile bounds;
+    int stride;
+    Color* sum;
+    float* weight;
+    const Filter* filter;
+    
+    // a sample taken at offset (in [0, 1)^2) within pixel (col, row)
+    void addSample(int col, int row, const glm::vec2& offset, const Color& radiance);
+    
+    /**
+     * the two halves of addSample, for integrators that accumulate a sample's radiance a piece at a time (e.g. one
+     * bounce of a batch at a time): the sample's weight once, and every piece of its radiance as it comes in
+     *
+     */
+    void addWeight(int col, int row, const glm::vec2& offset);
+    void addRadiance(int col, int row, const glm::vec2& offset, const Color& radiance);
+    
+    // calls add(index into sum/weight, filter weight) for every pixel in bounds the sample reaches
+    template <typename Add>
+    void forEachPixel(int col, int row, const glm::vec2& offset, const Add& add) const;
+};
+
+struct Film {
+    /**
+     * a film for filling in accumulator (whose sums and weights must start out zero, sized for the image) one tile
+     * at a time. tiles must not overlap, and each one may only be filled in by one thread
+     *
+     */
+    Film(Accumulator& accumulator, const Filter& filter, const std::vector<Tile>& tiles);
+    
+    FilmTile tile(size_t tileIndex);
+    
+    // the tile grown by the filter's margin, clipped to the image
+    Tile paddedBounds(size_t tileIndex) const;
+    
+    /**
+     * radiance for the pixel at raster position (in pixels from the top left of the image) that carries no weight of
+     * its own, so it ends up divided by the weight of the pixel's samples, i.e. (filters being normalized) by about
+     * how many there were. safe to call from any number of threads at once, and for any pixel of the image
+     *
+     */
+    void splat(const glm::vec2& raster, const Color& radiance);
+    
+    // adds the padded tile buffers and the splats into the accumulator. call it once every tile is done
+    void resolve();
+    
+    Accumulator& accumulator;
+    const Filter filter;
+    const std::vector<Tile>& tiles;
+    
+    // padded buffers of every tile, back to back, unless the filter has no margin
+    std::vector<size_t> tileOffsets;
+    std::vector<Color> tileSums;
+    std::vector<float> tileWeights;
+    
+    // kNumSplatShards copies of the image's rgb sums, only allocated once something is splatted
+    static const int kNumSplatShards = 8;
+    std::once_flag splatsAllocated;
+    std::unique_ptr<std::atomic<float>[]> splats;
+};
+
+#endif /* film_hpp */
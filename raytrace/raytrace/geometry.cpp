@@ -8,10 +8,54 @@
 
 #include "geometry.hpp"
 
+#include "stats.hpp"
+
+#include <algorithm>
 #include <iostream>
 
+void Bounds::extend(const glm::vec3& point) {
+    min = glm::min(min, point);
+    max = glm::max(max, point);
+}
+
+void Bounds::extend(const Bounds& other) {
+    min = glm::min(min, other.min);
+    max = glm::max(max, other.max);
+}
+
+float Bounds::surfaceArea() const {
+    if (min.x > max.x) {
+        return 0;
+    }
+    glm::vec3 extent = max - min;
+    return 2 * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+}
+
+// slab test: the ray is inside the box where it is between all three pairs of planes at once
+float Bounds::intersect(const Ray& ray, const glm::vec3& inverseDirection, float maxDistance) const {
+    float enter = 0;
+    float exit = maxDistance;
+    for (int axis = 0; axis < 3; axis++) {
+        float t1 = (min[axis] - ray.origin[axis]) * inverseDirection[axis];
+        float t2 = (max[axis] - ray.origin[axis]) * inverseDirection[axis];
+        enter = std::max(enter, std::min(t1, t2));
+        exit = std::min(exit, std::max(t1, t2));
+    }
+    return enter <= exit ? enter : -1.0;
+}
+
+Bounds padBounds(Bounds bounds) {
+    const glm::vec3 magnitude = glm::max(glm::abs(bounds.min), glm::abs(bounds.max));
+    const float padding = 1e-4 * std::max(1.0f, std::max(magnitude.x, std::max(magnitude.y, magnitude.z)));
+    bounds.min -= glm::vec3(padding);
+    bounds.max += glm::vec3(padding);
+    return bounds;
+}
+
 // borrowed from https://viclw17.github.io/2018/07/16/raytracing-ray-sphere-intersection
 float Sphere::intersect(const Ray& ray, glm::vec3& intersection) {
+    STATS_COUNT(SphereTests);
+    STATS_TIME(SphereIntersect);
     glm::vec3 sphereToOrigin = ray.origin - center;
     float a = glm::dot(ray.direction, ray.direction);
     float b = 2.0 * glm::dot(sphereToOrigin, ray.direction);
@@ -26,6 +70,8 @@ float Sphere::intersect(const Ray& ray, glm::vec3& intersection) {
 }
 
 float AxisAlignedPlane::intersect(const Ray& ray, glm::vec3& intersection) {
+    STATS_COUNT(PlaneTests);
+    STATS_TIME(PlaneIntersect);
     Ray rotatedRay = ray;
     
     rotatedRay.origin.x = cos(yAxisRotation) * ray.origin.x - sin(yAxisRotation) * ray.origin.z;
@@ -56,7 +102,18 @@ glm::vec3 Sphere::normal(const glm::vec3& intersectionPoint) {
     return glm::normalize(intersectionPoint - center);
 }
 
-glm::vec3 AxisAlignedPlane::normal(const glm::vec3& intersectionPoint) {
+Bounds Sphere::bounds() {
+    Bounds bounds;
+    bounds.extend(center - glm::vec3(radius));
+    bounds.extend(center + glm::vec3(radius));
+    return padBounds(bounds);
+}
+
+void Sphere::translate(const glm::vec3& offset) {
+    center += offset;
+}
+
+glm::vec3 AxisAlignedPlane::normal(const glm::vec3& /* intersectionPoint */) {
     glm::vec3 normalVector(0, 0, 0);
     normalVector[constAxisIndex] = facingAxis ? 1 : -1;
     
@@ -66,45 +123,103 @@ glm::vec3 AxisAlignedPlane::normal(const glm::vec3& intersectionPoint) {
     return rotatedNormal;
 }
 
+Bounds AxisAlignedPlane::bounds() {
+    // the rectangle's corners in the plane's own (rotated) frame, taken back to world space the same way as hits
+    Bounds bounds;
+    for (float varAxis1 : { varAxis11, varAxis12 }) {
+        for (float varAxis2 : { varAxis21, varAxis22 }) {
+            glm::vec3 corner(0, 0, 0);
+            corner[varAxis1Index] = varAxis1;
+            corner[varAxis2Index] = varAxis2;
+            corner[constAxisIndex] = constAxis;
+            
+            glm::vec3 worldCorner = corner;
+            worldCorner.x =  cos(yAxisRotation) * corner.x + sin(yAxisRotation) * corner.z;
+            worldCorner.z = -sin(yAxisRotation) * corner.x + cos(yAxisRotation) * corner.z;
+            bounds.extend(worldCorner);
+        }
+    }
+    return padBounds(bounds);
+}
+
+void AxisAlignedPlane::translate(const glm::vec3& offset) {
+    // the plane is stored in its rotated frame, so the offset has to be rotated into it as well
+    glm::vec3 rotatedOffset = offset;
+    rotatedOffset.x = cos(yAxisRotation) * offset.x - sin(yAxisRotation) * offset.z;
+    rotatedOffset.z = sin(yAxisRotation) * offset.x + cos(yAxisRotation) * offset.z;
+    
+    varAxis11 += rotatedOffset[varAxis1Index];
+    varAxis12 += rotatedOffset[varAxis1Index];
+    varAxis21 += rotatedOffset[varAxis2Index];
+    varAxis22 += rotatedOffset[varAxis2Index];
+    constAxis += rotatedOffset[constAxisIndex];
+}
+
 Box::Box(const glm::vec3& minCorner,
          const glm::vec3& maxCorner,
          const float yAxisRotation,
-         std::shared_ptr<Material> material) : Geometry(material) {
-    sides.push_back(std::make_shared<XYPlane>(minCorner.x, minCorner.y, maxCorner.x, maxCorner.y, minCorner.z, false, yAxisRotation, material)); // back
-    sides.push_back(std::make_shared<XYPlane>(minCorner.x, minCorner.y, maxCorner.x, maxCorner.y, maxCorner.z, true, yAxisRotation, material)); // front
-    sides.push_back(std::make_shared<XZPlane>(minCorner.x, minCorner.z, maxCorner.x, maxCorner.z, minCorner.y, false, yAxisRotation, material)); // bottom
-    sides.push_back(std::make_shared<XZPlane>(minCorner.x, minCorner.z, maxCorner.x, maxCorner.z, maxCorner.y, true, yAxisRotation, material)); // top
-    sides.push_back(std::make_shared<YZPlane>(minCorner.y, minCorner.z, maxCorner.y, maxCorner.z, minCorner.x, false, yAxisRotation, material)); // left
-    sides.push_back(std::make_shared<YZPlane>(minCorner.y, minCorner.z, maxCorner.y, maxCorner.z, maxCorner.x, true, yAxisRotation, material)); // right
+         Material* material) : Geometry(material), yAxisRotation(yAxisRotation) {
+    // the sides are held by value, which keeps them next to each other in memory (and a box to a single allocation)
+    sides[0] = XYPlane(minCorner.x, minCorner.y, maxCorner.x, maxCorner.y, minCorner.z, false, yAxisRotation, material); // back
+    sides[1] = XYPlane(minCorner.x, minCorner.y, maxCorner.x, maxCorner.y, maxCorner.z, true, yAxisRotation, material); // front
+    sides[2] = XZPlane(minCorner.x, minCorner.z, maxCorner.x, maxCorner.z, minCorner.y, false, yAxisRotation, material); // bottom
+    sides[3] = XZPlane(minCorner.x, minCorner.z, maxCorner.x, maxCorner.z, maxCorner.y, true, yAxisRotation, material); // top
+    sides[4] = YZPlane(minCorner.y, minCorner.z, maxCorner.y, maxCorner.z, minCorner.x, false, yAxisRotation, material); // left
+    sides[5] = YZPlane(minCorner.y, minCorner.z, maxCorner.y, maxCorner.z, maxCorner.x, true, yAxisRotation, material); // right
 }
 
 float Box::intersect(const Ray& ray, glm::vec3& intersection) {
-    std::shared_ptr<AxisAlignedPlane> closestSide;
+    STATS_COUNT(BoxTests);
+    STATS_TIME(BoxIntersect);
     float closestIntersection = std::numeric_limits<float>::max();
     glm::vec3 closestIntersectionPoint;
     
-    for (const std::shared_ptr<AxisAlignedPlane>& side : sides) {
+    for (AxisAlignedPlane& side : sides) {
         glm::vec3 intersectionPoint;
-        float t = side->intersect(ray, intersectionPoint);
+        float t = side.intersect(ray, intersectionPoint);
         if (t > 0.0 && t < closestIntersection) {
             closestIntersection = t;
             closestIntersectionPoint = intersectionPoint;
-            closestSide = side;
         }
     }
     
     if (closestIntersection < std::numeric_limits<float>::max()) {
         intersection = closestIntersectionPoint;
-        intersectedSideNormal = closestSide->normal(closestIntersectionPoint);
         return closestIntersection;
     }
     
-    intersectedSideNormal = glm::vec3(0, 0, 0); // no normal if no intersection
     return -1.0;
 }
 
 glm::vec3 Box::normal(const glm::vec3& intersectionPoint) {
-    // this is poor design, but think fixing it would be a bit of a pain, so just storing the value from intersect
-    // and just assuming that the normal is always gonna be called after a call to intersect()
-    return intersectedSideNormal;
+    // recovered from the point itself (rather than remembered from the last intersect call) so that concurrent
+    // render threads can share the box: the hit lies on the side whose plane it is closest to in the box's frame
+    glm::vec3 rotatedPoint = intersectionPoint;
+    rotatedPoint.x = cos(yAxisRotation) * intersectionPoint.x - sin(yAxisRotation) * intersectionPoint.z;
+    rotatedPoint.z = sin(yAxisRotation) * intersectionPoint.x + cos(yAxisRotation) * intersectionPoint.z;
+    
+    AxisAlignedPlane* closestSide = &sides[0];
+    float closestDistance = std::numeric_limits<float>::max();
+    for (AxisAlignedPlane& side : sides) {
+        float distance = fabs(rotatedPoint[side.constAxisIndex] - side.constAxis);
+        if (distance < closestDistance) {
+            closestDistance = distance;
+            closestSide = &side;
+        }
+    }
+    return closestSide->normal(intersectionPoint);
+}
+
+Bounds Box::bounds() {
+    Bounds bounds;
+    for (AxisAlignedPlane& side : sides) {
+        bounds.extend(side.bounds());
+    }
+    return bounds;
+}
+
+void Box::translate(const glm::vec3& offset) {
+    for (AxisAlignedPlane& side : sides) {
+        side.translate(offset);
+    }
 }
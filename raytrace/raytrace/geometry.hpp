@@ -12,28 +12,62 @@
 #include "material.hpp"
 #include "util.hpp"
 
+#include <array>
+#include <limits>
+
+// axis aligned bounding box, which starts out empty (min > max) until points are added to it
+struct Bounds {
+    glm::vec3 min = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 max = glm::vec3(-std::numeric_limits<float>::max());
+    
+    void extend(const glm::vec3& point);
+    void extend(const Bounds& other);
+    
+    glm::vec3 center() const {
+        return 0.5f * (min + max);
+    }
+    
+    float surfaceArea() const;
+    
+    // distance along the ray at which it enters the box, or -1 if it misses it or only gets there past maxDistance.
+    // inverseDirection is 1 / ray.direction, which callers precompute once per ray
+    float intersect(const Ray& ray, const glm::vec3& inverseDirection, float maxDistance) const;
+};
+
+// primitive boxes are padded a little so that rounding in intersect (e.g. through a plane's rotation) never puts a hit
+// just outside the box, and so that flat primitives do not give zero thickness boxes
+Bounds padBounds(Bounds bounds);
+
 struct Geometry {
-    std::shared_ptr<Material> material;
+    Material* material = nullptr; // owned by the scene, along with the geometry itself (see Scene::arena)
     
     Geometry() {}
-    Geometry(std::shared_ptr<Material> material) : material(material) {}
+    Geometry(Material* material) : material(material) {}
     
     virtual float intersect(const Ray& ray, glm::vec3& intersection) = 0;
     virtual glm::vec3 normal(const glm::vec3& intersectionPoint) = 0;
+    
+    // (conservative) box around every point intersect can return
+    virtual Bounds bounds() = 0;
+    
+    // moves the object by offset in world space, for animation
+    virtual void translate(const glm::vec3& offset) = 0;
 };
 
 struct Sphere : public Geometry {
     glm::vec3 center;
     float radius;
     
-    Sphere() : radius(0), center(glm::vec3(0, 0, 0)) {}
+    Sphere() : center(glm::vec3(0, 0, 0)), radius(0) {}
     
     Sphere(const glm::vec3& center,
            float radius,
-           const std::shared_ptr<Material> material) : center(center), radius(radius), Geometry(material) {}
+           Material* material) : Geometry(material), center(center), radius(radius) {}
     
     float intersect(const Ray& ray, glm::vec3& intersection) override;
     glm::vec3 normal(const glm::vec3& intersectionPoint) override;
+    Bounds bounds() override;
+    void translate(const glm::vec3& offset) override;
 };
 
 struct AxisAlignedPlane : public Geometry {
@@ -56,7 +90,8 @@ struct AxisAlignedPlane : public Geometry {
                      const int constAxisIndex,
                      const bool facingAxis, // determines direction of normal
                      const float yAxisRotation,
-                     std::shared_ptr<Material> material) :
+                     Material* material) :
+                        Geometry(material),
                         varAxis11(varAxis11),
                         varAxis21(varAxis21),
                         varAxis12(varAxis12),
@@ -66,12 +101,13 @@ struct AxisAlignedPlane : public Geometry {
                         varAxis2Index(varAxis2Index),
                         constAxisIndex(constAxisIndex),
                         facingAxis(facingAxis),
-                        yAxisRotation(yAxisRotation),
-                        Geometry(material) {}
+                        yAxisRotation(yAxisRotation) {}
     
     float intersect(const Ray& ray, glm::vec3& intersection) override;
     float intersect(const Ray& ray, glm::vec3& intersection, const glm::vec3& offset);
     glm::vec3 normal(const glm::vec3& intersectionPoint) override;
+    Bounds bounds() override;
+    void translate(const glm::vec3& offset) override;
 };
 
 struct XYPlane : public AxisAlignedPlane {
@@ -82,7 +118,7 @@ struct XYPlane : public AxisAlignedPlane {
             const float z,
             const bool facingAxis, // determines direction of normal
             const float yAxisRotation,
-            std::shared_ptr<Material> material) : AxisAlignedPlane(x1, y1, x2, y2, z, 0, 1, 2, facingAxis, yAxisRotation, material) {}
+            Material* material) : AxisAlignedPlane(x1, y1, x2, y2, z, 0, 1, 2, facingAxis, yAxisRotation, material) {}
 };
 
 struct XZPlane : public AxisAlignedPlane {
@@ -93,7 +129,7 @@ struct XZPlane : public AxisAlignedPlane {
             const float y,
             const bool facingAxis, // determines direction of normal
             const float yAxisRotation,
-            std::shared_ptr<Material> material) : AxisAlignedPlane(x1, z1, x2, z2, y, 0, 2, 1, facingAxis, yAxisRotation, material) {}
+            Material* material) : AxisAlignedPlane(x1, z1, x2, z2, y, 0, 2, 1, facingAxis, yAxisRotation, material) {}
 };
 
 struct YZPlane : public AxisAlignedPlane {
@@ -104,21 +140,23 @@ struct YZPlane : public AxisAlignedPlane {
             const float x,
             const bool facingAxis, // determines direction of normal
             const float yAxisRotation,
-            std::shared_ptr<Material> material) : AxisAlignedPlane(y1, z1, y2, z2, x, 1, 2, 0, facingAxis, yAxisRotation, material) {}
+            Material* material) : AxisAlignedPlane(y1, z1, y2, z2, x, 1, 2, 0, facingAxis, yAxisRotation, material) {}
 };
 
 
 struct Box : public Geometry {
-    std::vector<std::shared_ptr<AxisAlignedPlane>> sides;
-    glm::vec3 intersectedSideNormal;
+    std::array<AxisAlignedPlane, 6> sides;
+    float yAxisRotation;
     
     Box(const glm::vec3& minCorner,
         const glm::vec3& maxCorner,
         const float yAxisRotation,
-        std::shared_ptr<Material> material);
+        Material* material);
     
     float intersect(const Ray& ray, glm::vec3& intersection) override;
     glm::vec3 normal(const glm::vec3& intersectionPoint) override;
+    Bounds bounds() override;
+    void translate(const glm::vec3& offset) override;
 };
 
 #endif /* geometry_hpp */
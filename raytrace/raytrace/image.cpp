@@ -0,0 +1,131 @@
+/**
+ * @file image.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "image.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+
+bool writePFM(const std::string& filename, int width, int height, const std::vector<Color>& pixels) {
+    std::ofstream out(filename, std::ios::binary);
+    out << "PF\n" << width << ' ' << height << "\n-1.0\n"; // negative scale marks little endian
+    for (int row = height - 1; row >= 0; row--) {
+        for (int col = 0; col < width; col++) {
+            const Color& color = pixels[row * width + col];
+            const float rgb[3] = { color.x, color.y, color.z };
+            out.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+bool writePPM(const std::string& filename, int width, int height, const std::vector<Color>& pixels) {
+    std::ofstream out(filename);
+    out << "P3\n" << width << ' ' << height << "\n255\n";
+    for (const Color& color : pixels) {
+        for (int channel = 0; channel < 3; channel++) {
+            out << static_cast<int>(255 * std::min(std::max(color[channel], 0.0f), 1.0f)) << (channel < 2 ? ' ' : '\n');
+        }
+    }
+    return static_cast<bool>(out);
+}
+
+void Accumulator::reset(int width, int height) {
+    this->width = width;
+    this->height = height;
+    sum.assign(width * height, Color(0, 0, 0));
+    samples.assign(width * height, 0);
+    weight.assign(width * height, 0.0f);
+}
+
+void Accumulator::merge(const Accumulator& other) {
+    for (size_t i = 0; i < sum.size(); i++) {
+        sum[i] += other.sum[i];
+        samples[i] += other.samples[i];
+        weight[i] += other.weight[i];
+    }
+}
+
+bool writeAccumulator(const std::string& filename, const Accumulator& accumulator) {
+    std::ofstream out(filename, std::ios::binary);
+    out << "RTACC2\n" << accumulator.width << ' ' << accumulator.height << '\n';
+    for (size_t i = 0; i < accumulator.sum.size(); i++) {
+        const float rgb[3] = { accumulator.sum[i].x, accumulator.sum[i].y, accumulator.sum[i].z };
+        out.write(reinterpret_cast<const char*>(rgb), sizeof(rgb));
+        out.write(reinterpret_cast<const char*>(&accumulator.samples[i]), sizeof(uint32_t));
+        out.write(reinterpret_cast<const char*>(&accumulator.weight[i]), sizeof(float));
+    }
+    return static_cast<bool>(out);
+}
+
+bool readAccumulator(const std::string& filename, Accumulator& accumulator) {
+    std::ifstream in(filename, std::ios::binary);
+    std::string magic;
+    int width, height;
+    in >> magic >> width >> height;
+    in.get(); // newline before the data
+    if (!in || (magic != "RTACC" && magic != "RTACC2") || width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    // files from before filters (plain RTACC) have no weights, since every sample weighed 1
+    const bool weighted = magic == "RTACC2";
+    accumulator.reset(width, height);
+    for (size_t i = 0; i < accumulator.sum.size(); i++) {
+        float rgb[3];
+        in.read(reinterpret_cast<char*>(rgb), sizeof(rgb));
+        in.read(reinterpret_cast<char*>(&accumulator.samples[i]), sizeof(uint32_t));
+        accumulator.sum[i] = Color(rgb[0], rgb[1], rgb[2]);
+        accumulator.weight[i] = static_cast<float>(accumulator.samples[i]);
+        if (weighted) {
+            in.read(reinterpret_cast<char*>(&accumulator.weight[i]), sizeof(float));
+        }
+    }
+    return static_cast<bool>(in);
+}
+
+bool writeRender(const std::string& filename, const Accumulator& accumulator) {
+    std::ofstream out(filename);
+    out << "P3\n" << accumulator.width << ' ' << accumulator.height << "\n255\n";
+    for (size_t i = 0; i < accumulator.sum.size(); i++) {
+        // filters with negative lobes (see film.hpp) can ring below zero next to bright edges
+        const Color mean = glm::max(accumulator.mean(i), Color(0, 0, 0));
+        out << static_cast<int>(255 * std::sqrt(mean.x)) << ' '
+            << static_cast<int>(255 * std::sqrt(mean.y)) << ' '
+            << static_cast<int>(255 * std::sqrt(mean.z)) << '\n';
+    }
+    return static_cast<bool>(out);
+}
+
+bool replaceRender(const std::string& filename, const Accumulator& accumulator) {
+    const std::string temporary = filename + ".tmp";
+    return writeRender(temporary, accumulator) && std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+bool readPFM(const std::string& filename, int& width, int& height, std::vector<Color>& pixels) {
+    std::ifstream in(filename, std::ios::binary);
+    std::string magic;
+    float scale;
+    in >> magic >> width >> height >> scale;
+    in.get(); // single whitespace character before the data
+    if (!in || magic != "PF" || scale > 0 || width <= 0 || height <= 0) {
+        return false;
+    }
+    
+    pixels.assign(width * height, Color(0, 0, 0));
+    for (int row = height - 1; row >= 0; row--) {
+        for (int col = 0; col < width; col++) {
+            float rgb[3];
+            in.read(reinterpret_cast<char*>(rgb), sizeof(rgb));
+            pixels[row * width + col] = Color(rgb[0], rgb[1], rgb[2]);
+        }
+    }
+    return static_cast<bool>(in);
+}
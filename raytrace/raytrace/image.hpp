@@ -0,0 +1,67 @@
+/**
+ * @file image.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef image_hpp
+#define image_hpp
+
+#include "util.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Floating point images are kept as PFM (http://www.pauldebevec.com/Research/HDR/PFM/), which stores raw little
+ * endian RGB floats bottom row first. Unlike the PPM output this keeps the full radiance, so images can be compared
+ * or combined after the fact. pixels are row major, top row first, in the same layout render() returns
+ *
+ */
+bool writePFM(const std::string& filename, int width, int height, const std::vector<Color>& pixels);
+bool readPFM(const std::string& filename, int& width, int& height, std::vector<Color>& pixels);
+
+/**
+ * Running sums of a (possibly partial) render: the filter weighted sum of the samples around each pixel, the total
+ * weight of those samples, and how many samples were taken in the pixel itself, so that the partial renders of
+ * several shards can be merged into the mean over all of them. with the default box filter (see film.hpp) every
+ * sample weighs 1, and the weight is just the count again. stored as raw little endian floats, uint32 counts and
+ * float weights after a short text header
+ *
+ */
+struct Accumulator {
+    int width = 0;
+    int height = 0;
+    std::vector<Color> sum;
+    std::vector<uint32_t> samples;
+    std::vector<float> weight;
+    
+    // sized for a width x height image with nothing in it yet
+    void reset(int width, int height);
+    
+    // adds in another accumulator of the same size
+    void merge(const Accumulator& other);
+    
+    // the pixel's weighted mean, or black if no samples reached it
+    Color mean(size_t pixel) const {
+        return weight[pixel] != 0 ? sum[pixel] / weight[pixel] : Color(0, 0, 0);
+    }
+};
+
+bool writeAccumulator(const std::string& filename, const Accumulator& accumulator);
+bool readAccumulator(const std::string& filename, Accumulator& accumulator);
+
+// the final image: each pixel's mean (negatives clamped to 0), gamma corrected (gamma 2) and written as a plain PPM
+bool writeRender(const std::string& filename, const Accumulator& accumulator);
+
+// writeRender to a temporary file that is then renamed over filename, so that a viewer watching it never sees a
+// partially written image
+bool replaceRender(const std::string& filename, const Accumulator& accumulator);
+
+// plain 8 bit PPM of colors already in [0, 1] (values outside are clamped, and no gamma is applied)
+bool writePPM(const std::string& filename, int width, int height, const std::vector<Color>& pixels);
+
+#endif /* image_hpp */
@@ -6,27 +6,49 @@
  *
  */
 
+#include "animation.hpp"
 #include "camera.hpp"
+#include "image.hpp"
 #include "material.hpp"
+#include "profile.hpp"
+#include "render.hpp"
 #include "scene.hpp"
+#include "server.hpp"
+#include "stats.hpp"
 
-#include <fstream>
+#include <chrono>
 #include <iostream>
 
 #include <gflags/gflags.h>
-#include <glm/gtc/random.hpp>
 
 DEFINE_string(filename, "", "Output file for rendering");
 DEFINE_int32(width, 0, "Width of rendering");
 DEFINE_int32(height, 0, "Height of rendering");
 DEFINE_int32(samples, 5, "Number of samples per pixel");
 DEFINE_int32(bounces, 1, "Depth of bounces");
-
-void writeColor(std::ofstream &out, Color& color) {
-    out << static_cast<int>(255 * sqrt(color.x / FLAGS_samples)) << ' '
-        << static_cast<int>(255 * sqrt(color.y / FLAGS_samples)) << ' '
-        << static_cast<int>(255 * sqrt(color.z / FLAGS_samples)) << '\n';
-}
+DEFINE_string(integrator, "recursive", "Path tracing engine: recursive (castRay per sample) or wavefront (batched stages)");
+DEFINE_string(sampler, "random", "Placement of samples within a pixel: random or stratified");
+DEFINE_bool(fast_math, false, "Use approximate, branch free sampling math (same image in expectation, not bit for bit)");
+DEFINE_string(filter, "box", "Reconstruction filter weighting samples into the pixels around them: box, tent, gaussian or mitchell");
+DEFINE_double(filter_radius, 0, "Radius of the filter in pixels, up to 4 (0 picks the filter's usual radius)");
+DEFINE_bool(shading_cache, false, "Adapt diffuse sampling per cell of a hash grid to where the light and glass ball are visible");
+DEFINE_double(shading_cache_cell_size, 0, "Edge of the shading cache's cells (0 picks a sixteenth of the smallest object)");
+DEFINE_int32(threads, 0, "Number of render threads (0 uses all hardware threads)");
+DEFINE_int32(tile_size, 32, "Edge length in pixels of the tiles handed to render threads");
+DEFINE_string(scene, "cornell", "Scene to render: cornell or balls");
+DEFINE_string(mesh, "", "Add this mesh (packed with raytrace_meshpack) to the scene, as a white diffuse surface");
+DEFINE_string(shard, "", "Render only shard i of N of the frame, given as i/N (needs --partial to write the result to)");
+DEFINE_string(shard_mode, "tiles", "How frames are split between shards: tiles (every Nth tile) or samples (a slice of each pixel's samples)");
+DEFINE_string(partial, "", "Write the raw per pixel sample sums, counts and filter weights to this file, for merging with raytrace_merge");
+DEFINE_double(time_budget, 0, "Render progressively for this many seconds instead (--samples becomes the most to take), rewriting the output after every pass");
+DEFINE_string(animation, "", "Render the frames of this animation file (see animation.hpp) to --filename, with a run of #s standing for the frame number");
+DEFINE_bool(reuse_lighting, false, "In animations, reuse diffuse lighting converged in earlier frames on static objects (recursive integrator only)");
+DEFINE_double(reuse_cell_size, 0, "Edge length of the cells lighting is reused over (0 picks one from the size of the scene's objects)");
+DEFINE_string(server, "", "Instead of rendering one image, serve render jobs (see server.hpp) from stdin (-) or a unix socket at this path");
+DEFINE_string(time_heatmap, "", "Write a heatmap of the wall time spent on each pixel to this PPM file");
+DEFINE_string(intersection_heatmap, "", "Write a heatmap of primitive tests per pixel to this PPM file (needs a RAYTRACE_STATS build)");
+DEFINE_string(timeline, "", "Write which thread rendered which tile when as a Chrome trace JSON to this file");
+DEFINE_string(stats, "", "Write hot path counters and timers as JSON to this file (needs a RAYTRACE_STATS build)");
 
 /**
  * Point on choice of coordinate system
@@ -38,40 +60,169 @@ void writeColor(std::ofstream &out, Color& color) {
 int main(int argc, char *argv[]) {
     gflags::ParseCommandLineFlags(&argc, &argv, true);
     
-    std::ofstream result(FLAGS_filename);
-    result << "P3\n" << FLAGS_width << ' ' << FLAGS_height << "\n255\n";
+    if (!FLAGS_server.empty()) {
+        RenderServer server(FLAGS_threads);
+        if (FLAGS_server == "-") {
+            server.serveStream(std::cin, std::cout);
+            return 0;
+        }
+        return server.serveSocket(FLAGS_server) ? 0 : 1;
+    }
     
-    const float imageAspectRatio = FLAGS_width / FLAGS_height;
+    RenderSettings settings;
+    settings.width = FLAGS_width;
+    settings.height = FLAGS_height;
+    settings.samples = FLAGS_samples;
+    settings.bounces = FLAGS_bounces;
+    settings.tileSize = FLAGS_tile_size;
+    settings.threads = FLAGS_threads;
+    settings.fastMath = FLAGS_fast_math;
+    settings.shadingCache = FLAGS_shading_cache;
+    settings.shadingCacheCellSize = FLAGS_shading_cache_cell_size;
+    if (!parseIntegrator(FLAGS_integrator, settings.integrator)) {
+        std::cerr << "unknown integrator: " << FLAGS_integrator << std::endl;
+        return 1;
+    }
+    if (!parseSampler(FLAGS_sampler, settings.sampler)) {
+        std::cerr << "unknown sampler: " << FLAGS_sampler << std::endl;
+        return 1;
+    }
+    FilterType filterType;
+    if (!parseFilterType(FLAGS_filter, filterType)) {
+        std::cerr << "unknown filter: " << FLAGS_filter << std::endl;
+        return 1;
+    }
+    if (FLAGS_filter_radius > kMaxFilterRadius) {
+        std::cerr << "--filter_radius can be at most " << kMaxFilterRadius << std::endl;
+        return 1;
+    }
+    settings.filter = Filter(filterType, FLAGS_filter_radius);
+    if (!FLAGS_shard.empty() && !parseShard(FLAGS_shard, settings.shard)) {
+        std::cerr << "shard must be i/N with 0 <= i < N: " << FLAGS_shard << std::endl;
+        return 1;
+    }
+    if (!parseShardMode(FLAGS_shard_mode, settings.shard.mode)) {
+        std::cerr << "unknown shard mode: " << FLAGS_shard_mode << std::endl;
+        return 1;
+    }
+    
+    // a shard's pixels are only a part of the frame, so they only make sense merged with the other shards
+    const bool sharded = settings.shard.count > 1;
+    if (sharded && FLAGS_partial.empty()) {
+        std::cerr << "--shard needs --partial to write the shard's result to" << std::endl;
+        return 1;
+    }
+    if (sharded && FLAGS_time_budget > 0) {
+        std::cerr << "--time_budget renders whole frames, it cannot be combined with --shard" << std::endl;
+        return 1;
+    }
+    
+    // profiles and stats are only collected over a single fixed sample render
+    const bool profiling = !FLAGS_time_heatmap.empty() || !FLAGS_intersection_heatmap.empty() || !FLAGS_timeline.empty();
+    if ((profiling || !FLAGS_stats.empty()) && (!FLAGS_animation.empty() || FLAGS_time_budget > 0)) {
+        std::cerr << "--time_heatmap, --intersection_heatmap, --timeline and --stats cannot be combined with "
+                  << "--animation or --time_budget" << std::endl;
+        return 1;
+    }
+    
+    Camera camera = generateCamera(FLAGS_width, FLAGS_height);
+    Scene scene;
+    if (!generateScene(FLAGS_scene, scene)) {
+        std::cerr << "unknown scene: " << FLAGS_scene << std::endl;
+        return 1;
+    }
+    if (!FLAGS_mesh.empty()) {
+        std::string error;
+        if (!scene.addMesh(FLAGS_mesh, scene.makeMaterial<Lambertian>(WHITE), error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        scene.bvh.build(scene.geometry);
+    }
     
-    const float theta = M_PI / 4;
-    float h = tan(theta/2);
-    float cameraCCDheight = 2.0 * h;
-    float cameraCCDwidth = imageAspectRatio * cameraCCDheight;
-    const float focal = 1.0;
-    const float aperture = 0.0;
+    if (!FLAGS_animation.empty()) {
+        Animation animation;
+        std::string error;
+        if (!readAnimation(FLAGS_animation, animation, error)) {
+            std::cerr << FLAGS_animation << ": " << error << std::endl;
+            return 1;
+        }
+        if (!animation.objects.empty() && animation.objects.rbegin()->first >= static_cast<int>(scene.geometry.size())) {
+            std::cerr << FLAGS_animation << ": the scene only has " << scene.geometry.size() << " objects" << std::endl;
+            return 1;
+        }
+        if (sharded || FLAGS_time_budget > 0) {
+            std::cerr << "--animation cannot be combined with --shard or --time_budget" << std::endl;
+            return 1;
+        }
+        if (FLAGS_reuse_lighting && settings.integrator != Integrator::Recursive) {
+            std::cerr << "--reuse_lighting only applies to the recursive integrator" << std::endl;
+            return 1;
+        }
+        
+        const auto start = std::chrono::steady_clock::now();
+        bool written = true;
+        renderAnimation(scene, animation, settings, FLAGS_reuse_lighting, FLAGS_reuse_cell_size,
+                        [&start, &written](int frame, const Accumulator& image) {
+            const std::string filename = frameFilename(FLAGS_filename, frame);
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "frame " << frame << " done after " << seconds << "s" << std::endl;
+            if (!writeRender(filename, image)) {
+                std::cerr << "could not write render to " << filename << std::endl;
+                written = false;
+            }
+        });
+        return written ? 0 : 1;
+    }
     
-    const glm::vec3 lookFrom = glm::vec3(0, 0, 0);
-    const glm::vec3 lookAt = glm::vec3(0, 0, -1);
+    if (!FLAGS_stats.empty() && !kStatsEnabled) {
+        std::cerr << "--stats needs a build with RAYTRACE_STATS defined, no stats will be written" << std::endl;
+    }
     
-    Camera camera(lookFrom, glm::vec2(cameraCCDwidth, cameraCCDheight), lookAt, focal, aperture);
-    Scene scene = generateCornellBoxScene();
+    if (!FLAGS_intersection_heatmap.empty() && !kStatsEnabled) {
+        std::cerr << "--intersection_heatmap needs a build with RAYTRACE_STATS defined, it will be all black" << std::endl;
+    }
     
-    for (int row = 0; row < FLAGS_height; row++) {
-        for (int col = 0; col < FLAGS_width; col++) {
-            Color color(0, 0, 0);
-            for (int sample = 0; sample < FLAGS_samples; sample++) {
-                // TODO: here is one spot where sampling can be done more intelligently! just uniform right now
-                glm::vec2 uv(
-                             ((float)col + glm::linearRand(0.0f, 1.0f)) / FLAGS_width,
-                             ((float)row + glm::linearRand(0.0f, 1.0f)) / FLAGS_height);
-                Ray ray = camera.generateRay(uv); // implicit origin of rays is the camera position
-                color += castRay(scene, ray, FLAGS_bounces);
+    if (FLAGS_time_budget > 0) {
+        const auto start = std::chrono::steady_clock::now();
+        Accumulator accumulator = renderProgressive(scene, camera, settings, FLAGS_time_budget,
+                                                    [&start](const Accumulator& image, int pass) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            std::cerr << "pass " << pass << " done after " << seconds << "s" << std::endl;
+            if (!replaceRender(FLAGS_filename, image)) {
+                std::cerr << "could not write render to " << FLAGS_filename << std::endl;
             }
-            writeColor(result, color);
+        });
+        if (!FLAGS_partial.empty() && !writeAccumulator(FLAGS_partial, accumulator)) {
+            std::cerr << "could not write partial render to " << FLAGS_partial << std::endl;
+            return 1;
         }
+        return 0;
+    }
+    
+    RenderProfile profile;
+    Accumulator accumulator = render(scene, camera, settings, profiling ? &profile : nullptr);
+    if (!FLAGS_time_heatmap.empty()) {
+        writeHeatmap(FLAGS_time_heatmap, FLAGS_width, FLAGS_height, profile.pixelSeconds);
+    }
+    if (!FLAGS_intersection_heatmap.empty()) {
+        writeHeatmap(FLAGS_intersection_heatmap, FLAGS_width, FLAGS_height, profile.pixelTests);
+    }
+    if (!FLAGS_timeline.empty()) {
+        writeTimeline(FLAGS_timeline, profile.tileEvents);
+    }
+    if (!FLAGS_stats.empty() && kStatsEnabled && !writeStatsReport(FLAGS_stats, collectStats(), FLAGS_bounces)) {
+        std::cerr << "could not write stats to " << FLAGS_stats << std::endl;
     }
     
-    result.close();
+    if (!FLAGS_partial.empty() && !writeAccumulator(FLAGS_partial, accumulator)) {
+        std::cerr << "could not write partial render to " << FLAGS_partial << std::endl;
+        return 1;
+    }
+    if (!sharded && !writeRender(FLAGS_filename, accumulator)) {
+        std::cerr << "could not write render to " << FLAGS_filename << std::endl;
+        return 1;
+    }
     
     return 0;
 }
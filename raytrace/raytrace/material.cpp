@@ -9,16 +9,25 @@
 #include "material.hpp"
 
 
+#include "sampling.hpp"
 #include "scene.hpp"
+#include "shadingcache.hpp"
+#include "stats.hpp"
 
 #include <iostream>
 #include "math.h"
-#include <glm/gtc/random.hpp>
 
 // can be modified for arbitrary choice of function for sampling about z-axis
 glm::vec3 uniformlySampleHemisphere() {
-    float r1 = glm::linearRand(0.0f, 1.0f);
-    float r2 = glm::linearRand(0.0f, 1.0f);
+    float r1 = randomFloat(0.0f, 1.0f);
+    float r2 = randomFloat(0.0f, 1.0f);
+    
+    if (fastMathEnabled()) {
+        float sine, cosine;
+        fastSinCos(r1, sine, cosine);
+        float radial = sqrt(r2);
+        return glm::vec3(cosine * radial, sine * radial, sqrt(1 - r2));
+    }
     
     float phi = 2 * M_PI * r1;
     
@@ -31,10 +40,16 @@ glm::vec3 uniformlySampleHemisphere() {
 
 // can be modified for arbitrary choice of function for sampling about z-axis
 glm::vec3 uniformlySampleSphere(const float radius, const float dist_sq) {
-    float r1 = glm::linearRand(0.0f, 1.0f);
-    float r2 = glm::linearRand(0.0f, 1.0f);
+    float r1 = randomFloat(0.0f, 1.0f);
+    float r2 = randomFloat(0.0f, 1.0f);
     
     float z = 1 + r2 * (sqrt(1 - radius * radius / dist_sq) - 1);
+    if (fastMathEnabled()) {
+        float sine, cosine;
+        fastSinCos(r1, sine, cosine);
+        float radial = sqrt(fmax(0.0f, 1 - z * z));
+        return glm::vec3(cosine * radial, sine * radial, z);
+    }
     float phi = 2 * M_PI * r1;
     
     float x = cos(phi) * sqrt(1 - z * z);
@@ -46,6 +61,9 @@ glm::vec3 uniformlySampleSphere(const float radius, const float dist_sq) {
 // taken from https://raytracing.github.io/books/RayTracingTheRestOfYourLife.html#onedimensionalmcintegration
 glm::mat3 localCoordSystem(const glm::vec3& n) {
     glm::vec3 normal = glm::normalize(n);
+    if (fastMathEnabled()) {
+        return branchlessBasis(normal);
+    }
     glm::vec3 a = (fabs(normal.x) > 0.9) ? glm::vec3(0, 1, 0) : glm::vec3(1, 0, 0);
     
     glm::vec3 z = normal;
@@ -65,13 +83,16 @@ const int sizeX = 500;
 const int sizeY = 500;
 const int sizeZ = 250;
 
+// stand-ins for the (hardcoded) light and glass ball the sampling mixture aims at, which are only ever intersected.
+// they are built once rather than on every call, since this runs on every diffuse and glossy bounce
+XZPlane samplingLight(-sizeX / 2.0, centerZ - sizeZ / 2.0, sizeX / 2.0, centerZ + sizeZ / 2.0, sizeY - .005, true, 0.0,
+                      nullptr);
+Sphere samplingSphere(glm::vec3(175.0, -3.0 * sizeY / 5.0, 200.0 + centerZ - sizeZ / 4.0), 200.0, nullptr);
+
 float computeLightPDF(const Ray& outbound) {
     // need to determine whether the ray intersect the light (if not, 0 PDF)
-    const std::shared_ptr<XZPlane> light = std::make_shared<XZPlane>(-sizeX / 2.0, centerZ - sizeZ / 2.0,
-                                                                     sizeX / 2.0, centerZ + sizeZ / 2.0,
-                                                                     sizeY - .005, true, 0.0, std::make_shared<Light>(LIGHT_GRAY));
     glm::vec3 intersectionPoint;
-    float intersection = light->intersect(outbound, intersectionPoint);
+    float intersection = samplingLight.intersect(outbound, intersectionPoint);
     if (intersection < 0) {
         return 0.0;
     }
@@ -86,47 +107,148 @@ float computeLightPDF(const Ray& outbound) {
 }
 
 float computeSpherePDF(const Ray& outbound) {
-    const std::shared_ptr<Sphere> glassBall = std::make_shared<Sphere>(glm::vec3(175.0, -3.0 * sizeY / 5.0, 200.0 + centerZ - sizeZ / 4.0),
-                                                                       200.0, std::make_shared<Dielectric>(1.5));
     glm::vec3 intersectionPoint;
-    float intersection = glassBall->intersect(outbound, intersectionPoint);
+    float intersection = samplingSphere.intersect(outbound, intersectionPoint);
     if (intersection < 0) {
         return 0.0;
     }
     
-    glm::vec3 dirToSphere = glassBall->center - outbound.origin;
+    glm::vec3 dirToSphere = samplingSphere.center - outbound.origin;
     float distToSphere2 = glm::dot(dirToSphere, dirToSphere);
     
-    const float ratio = glassBall->radius * glassBall->radius / distToSphere2;
+    const float ratio = samplingSphere.radius * samplingSphere.radius / distToSphere2;
     float cosThetaMax = sqrt(1 - ratio);
     float solidAngle = 2 * M_PI * (1 - cosThetaMax);
 
     return 1.0f / solidAngle;
 }
 
-// TODO: here is the other major spot for improving sampling from the BRDF function
-glm::vec3 sampleUnitSphere() {
-    while (true) {
-        glm::vec3 proposal(
-                           2.0 * (glm::linearRand(0.0f, 1.0f) - 0.5),
-                           2.0 * (glm::linearRand(0.0f, 1.0f) - 0.5),
-                           2.0 * (glm::linearRand(0.0f, 1.0f) - 0.5)
-                           );
-        if (glm::length(proposal) <= 1.0) {
-            return proposal;
-        }
+// picks a uniformly random point on the (hardcoded) ceiling light and returns the direction to it, i.e. the
+// sampling distribution whose density is computeLightPDF
+glm::vec3 sampleLightDirection(const glm::vec3& intersection) {
+    glm::vec3 randomLightPoint(
+                               randomFloat(-sizeX / 2.0, sizeX / 2.0),
+                               sizeY - .005,
+                               randomFloat(centerZ - sizeZ / 2.0, centerZ + sizeZ / 2.0)
+    );
+    return glm::normalize(randomLightPoint - intersection);
+}
+
+// uniformly random direction within the cone the (hardcoded) glass ball subtends, whose density is computeSpherePDF
+glm::vec3 sampleSphereDirection(const glm::vec3& intersection) {
+    glm::vec3 directionToCenter = samplingSphere.center - intersection;
+    float sphereDistanceSq = glm::dot(directionToCenter, directionToCenter);
+    directionToCenter = glm::normalize(directionToCenter);
+    
+    glm::mat3 localBasis = localCoordSystem(directionToCenter);
+    glm::vec3 globalRandomDirection = uniformlySampleSphere(samplingSphere.radius, sphereDistanceSq);
+    return glm::normalize(localBasis * globalRandomDirection);
+}
+
+/* ***********************************************************************
+ * GGX microfacet helpers
+ * -----------------------------------------------------------------------
+ * All of these work in the local shading frame (normal along +z, see
+ * localCoordSystem), with alpha being the GGX roughness. Sampling uses the
+ * distribution of *visible* normals (Heitz 2018), which only ever proposes
+ * microfacets that face the viewer, so its pdf is D_v(m) = G1(v) (v.m) D(m) / v.z
+ * and the resulting estimator weight collapses to G2 / G1.
+ * *********************************************************************** */
+float ggxD(const glm::vec3& m, float alpha) {
+    if (m.z <= 0) {
+        return 0.0;
+    }
+    float alpha2 = alpha * alpha;
+    float denom = m.z * m.z * (alpha2 - 1) + 1;
+    return alpha2 / (M_PI * denom * denom);
+}
+
+float ggxLambda(const glm::vec3& w, float alpha) {
+    float cos2 = w.z * w.z;
+    if (cos2 <= 0) {
+        return 0.0;
     }
+    float tan2 = fmax(0.0, 1 - cos2) / cos2;
+    return (-1 + sqrt(1 + alpha * alpha * tan2)) / 2;
+}
+
+float ggxG1(const glm::vec3& w, float alpha) {
+    return 1.0 / (1.0 + ggxLambda(w, alpha));
+}
+
+// height-correlated masking-shadowing
+float ggxG2(const glm::vec3& wo, const glm::vec3& wi, float alpha) {
+    return 1.0 / (1.0 + ggxLambda(wo, alpha) + ggxLambda(wi, alpha));
 }
 
-Lambertian::Lambertian(const Color& texture) : texture(texture) {}
+// pdf of drawing microfacet normal m when looking from wo (wo.z > 0)
+float ggxVisibleNormalPDF(const glm::vec3& wo, const glm::vec3& m, float alpha) {
+    return ggxG1(wo, alpha) * fmax(0.0, glm::dot(wo, m)) * ggxD(m, alpha) / wo.z;
+}
+
+// taken from http://jcgt.org/published/0007/04/01/ (Heitz, "Sampling the GGX Distribution of Visible Normals")
+glm::vec3 sampleGGXVisibleNormal(const glm::vec3& wo, float alpha) {
+    float u1 = randomFloat(0.0f, 1.0f);
+    float u2 = randomFloat(0.0f, 1.0f);
+    
+    // stretch the view vector so we are sampling as though the roughness is 1
+    glm::vec3 vh = glm::normalize(glm::vec3(alpha * wo.x, alpha * wo.y, wo.z));
+    float lensq = vh.x * vh.x + vh.y * vh.y;
+    glm::vec3 t1 = lensq > 0 ? glm::vec3(-vh.y, vh.x, 0) / sqrtf(lensq) : glm::vec3(1, 0, 0);
+    glm::vec3 t2 = glm::cross(vh, t1);
+    
+    // uniformly sample the projected area of the visible hemisphere
+    float p1, p2;
+    if (fastMathEnabled()) {
+        glm::vec2 disc = concentricSampleDisc(u1, u2);
+        p1 = disc.x;
+        p2 = disc.y;
+    } else {
+        float r = sqrt(u1);
+        float phi = 2 * M_PI * u2;
+        p1 = r * cos(phi);
+        p2 = r * sin(phi);
+    }
+    float s = 0.5 * (1.0 + vh.z);
+    p2 = (1.0 - s) * sqrt(1.0 - p1 * p1) + s * p2;
+    
+    glm::vec3 nh = p1 * t1 + p2 * t2 + static_cast<float>(sqrt(fmax(0.0, 1.0 - p1 * p1 - p2 * p2))) * vh;
+    return glm::normalize(glm::vec3(alpha * nh.x, alpha * nh.y, fmax(0.0, nh.z)));
+}
+
+Color schlickFresnel(const Color& f0, float cosTheta) {
+    if (fastMathEnabled()) {
+        return f0 + (WHITE - f0) * pow5(1 - cosTheta);
+    }
+    return f0 + (WHITE - f0) * static_cast<float>(pow(1 - cosTheta, 5.0));
+}
+
+// Schlick's approximation for the reflectance of an interface with relative index of refraction eta
+float schlickReflectance(float cosTheta, float eta) {
+    float r0 = (1 - eta) / (1 + eta);
+    float r02 = r0 * r0;
+    if (fastMathEnabled()) {
+        return r02 + (1 - r02) * pow5(1 - cosTheta);
+    }
+    return r02 + (1 - r02) * pow((1 - cosTheta), 5.0);
+}
+
+// below this alpha, the microfacet lobe is numerically a delta function and is treated as perfectly specular
+const float kSpecularRoughness = 1e-3;
+
+// fraction of glossy samples that are instead drawn towards the light, which is scaled back for sharp lobes
+// since they almost never see the light anyway
+const float kGlossyLightAlpha = 0.5;
+
+Lambertian::Lambertian(const Color& texture, const SamplingMixture& mixture) : texture(texture), mixture(mixture) {}
+    
+ScatterRecord Lambertian::scatter(const Ray& /* in */,
+                                  const glm::vec3& intersection,
+                                  const glm::vec3& normal,
+                                  const bool /* inside */) const {
+    STATS_COUNT(LambertianSamples);
+    STATS_TIME(LambertianScatter);
     
-const bool Lambertian::scatter(const Ray& in,
-                               const glm::vec3& intersection,
-                               const glm::vec3& normal,
-                               const bool inside,
-                               Ray& out,
-                               Color& outColor,
-                               double& pdf) const {
     /* ***********************************************************************
      * Brief Interlude: Monte Carlo Importance Sampling
      * -----------------------------------------------------------------------
@@ -156,31 +278,24 @@ const bool Lambertian::scatter(const Ray& in,
      *
      * The PDF for rectangular light sources turns out to be simple: d(p,q)^2 / (cos(theta) * A)
      * *********************************************************************** */
+    ScatterRecord record;
     glm::vec3 outDirection;
     
+    // away from wherever the light or ball are hidden, if a shading cache is set (see shadingcache.hpp)
+    SamplingMixture mixture = this->mixture;
+    if (const ShadingCache* cache = threadShadingCache()) {
+        cache->adapt(intersection, normal, mixture);
+    }
+    
     // TODO: this is a TOTAL hack to get around the firefly issues seen in the renders -- unclear what the cause is
     const float kFireflyPdfThresh = 0.025;
-    while (pdf < kFireflyPdfThresh) {
-        std::vector<float> alphas = { .5, 0.0 } ; // mixing between light, sphere, and (implicit rest) random
-        const float randSampling = glm::linearRand(0.0f, 1.0f);
-        if (randSampling < alphas[0]) {
-            glm::vec3 randomLightPoint(
-                                       glm::linearRand(-sizeX / 2.0, sizeX / 2.0),
-                                       sizeY - .005,
-                                       glm::linearRand(centerZ - sizeZ / 2.0, centerZ + sizeZ / 2.0)
-            );
-            outDirection = glm::normalize(randomLightPoint - intersection);
+    while (record.pdf < kFireflyPdfThresh) {
+        const float randSampling = randomFloat(0.0f, 1.0f);
+        if (randSampling < mixture.light) {
+            outDirection = sampleLightDirection(intersection);
         }
-        else if (randSampling < alphas[1]) {
-            glm::vec3 sphereCenter = glm::vec3(175.0, -3.0 * sizeY / 5.0, 200.0 + centerZ - sizeZ / 4.0);
-            const float sphereRadius = 200.0;
-            glm::vec3 directionToCenter = sphereCenter - intersection;
-            float sphereDistanceSq = glm::dot(directionToCenter, directionToCenter);
-            directionToCenter = glm::normalize(directionToCenter);
-            
-            glm::mat3 localBasis = localCoordSystem(directionToCenter);
-            glm::vec3 globalRandomDirection = uniformlySampleSphere(sphereRadius, sphereDistanceSq);
-            outDirection = glm::normalize(localBasis * globalRandomDirection);
+        else if (randSampling < mixture.light + mixture.sphere) {
+            outDirection = sampleSphereDirection(intersection);
         }
         else {
             // need to do change of basis to do sampling from out of the normal of intersection
@@ -194,95 +309,222 @@ const bool Lambertian::scatter(const Ray& in,
             }
         }
         
-        out = Ray(outDirection, intersection);
-        outColor = texture;
+        record.out = Ray(outDirection, intersection);
+        record.color = texture;
         
-        float lightPDF = computeLightPDF(out);
-        float spherePDF = computeSpherePDF(out);
+        float lightPDF = mixture.light > 0 ? computeLightPDF(record.out) : 0.0f;
         float hemispherePDF = glm::dot(normal, outDirection) / M_PI; // PDF of *sampling* PDF (NOT necessarily scatter PDF)
-    //    pdf = alphas[0] * lightPDF + (alphas[1] - alphas[0]) * spherePDF + (1 - alphas[1]) * hemispherePDF;
-        pdf = alphas[0] * lightPDF + (1 - alphas[0]) * hemispherePDF;
+        record.pdf = mixture.light * lightPDF + (1 - mixture.light - mixture.sphere) * hemispherePDF;
+        if (mixture.sphere > 0) {
+            record.pdf += mixture.sphere * computeSpherePDF(record.out);
+        }
+        if (record.pdf < kFireflyPdfThresh) {
+            STATS_COUNT(FireflyResamples);
+        }
     }
     
-    return true;
+    record.didScatter = true;
+    return record;
+}
+
+Color Lambertian::emit(const glm::vec3& /* intersection */, const glm::vec3& /* normal */) const {
+    return Color(0, 0, 0);
 }
 
-double Lambertian::scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const {
+float Lambertian::scatterPDF(const Ray& /* in */, const glm::vec3& normal, const glm::vec3& outDirection) const {
     float cos = glm::dot(glm::normalize(normal), glm::normalize(outDirection));
     return fmax(0.001, cos / M_PI);
 }
 
 Metal::Metal(const Color& texture, float roughness) : texture(texture), roughness(roughness) {}
     
-const bool Metal::scatter(const Ray& in,
-                          const glm::vec3& intersection,
-                          const glm::vec3& normal,
-                          const bool inside,
-                          Ray& out,
-                          Color& outColor,
-                          double& pdf) const {
-    glm::vec3 outDirection = glm::reflect(in.direction, normal);
-    // have some degree of scattering in the BRDF if material is modelled as being rough
-    outDirection += sampleUnitSphere() * roughness;
-    outDirection = glm::normalize(outDirection);
-    
-    out = Ray(outDirection, intersection);
-    outColor = texture;
-    pdf = scatterPDF(in.direction, outDirection);
-    return glm::dot(outDirection, normal) > 0;
+ScatterRecord Metal::scatter(const Ray& in,
+                             const glm::vec3& intersection,
+                             const glm::vec3& normal,
+                             const bool /* inside */) const {
+    STATS_COUNT(MetalSamples);
+    STATS_TIME(MetalScatter);
+    ScatterRecord record;
+    if (roughness < kSpecularRoughness) {
+        glm::vec3 outDirection = glm::reflect(in.direction, normal);
+        record.out = Ray(outDirection, intersection);
+        // a perfect mirror keeps its plain color, as before the rough lobe existed
+        record.color = texture;
+        record.didScatter = glm::dot(outDirection, normal) > 0;
+        return record;
+    }
+    
+    glm::mat3 localBasis = localCoordSystem(normal);
+    glm::mat3 worldToLocal = glm::transpose(localBasis);
+    glm::vec3 wo = worldToLocal * -in.direction;
+    if (wo.z <= 0) {
+        return record;
+    }
+    
+    // one-sample MIS between the visible normals of the lobe and the light, weighted by the combined pdf below
+    const float lightAlpha = kGlossyLightAlpha * fmin(roughness, 1.0);
+    glm::vec3 outDirection;
+    if (randomFloat(0.0f, 1.0f) < lightAlpha) {
+        outDirection = sampleLightDirection(intersection);
+    } else {
+        glm::vec3 m = sampleGGXVisibleNormal(wo, roughness);
+        outDirection = glm::normalize(localBasis * glm::reflect(-wo, m));
+    }
+    
+    glm::vec3 wi = worldToLocal * outDirection;
+    if (wi.z <= 0) {
+        return record;
+    }
+    glm::vec3 m = glm::normalize(wo + wi);
+    
+    record.out = Ray(outDirection, intersection);
+    record.color = schlickFresnel(texture, glm::dot(wo, m));
+    
+    float lobePDF = ggxVisibleNormalPDF(wo, m, roughness) / (4 * glm::dot(wo, m));
+    record.pdf = lightAlpha * computeLightPDF(record.out) + (1 - lightAlpha) * lobePDF;
+    record.didScatter = record.pdf > 0;
+    return record;
 }
 
-double Metal::scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const {
-    return 0;
+Color Metal::emit(const glm::vec3& /* intersection */, const glm::vec3& /* normal */) const {
+    return Color(0, 0, 0);
 }
 
-Dielectric::Dielectric(const float ior) : ior(ior) {}
+// f * cos(theta_i) without the Fresnel term, which scatter() folds into the record's color
+float Metal::scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const {
+    if (roughness < kSpecularRoughness) {
+        return 0;
+    }
+    
+    glm::mat3 worldToLocal = glm::transpose(localCoordSystem(normal));
+    glm::vec3 wo = worldToLocal * -in.direction;
+    glm::vec3 wi = worldToLocal * glm::normalize(outDirection);
+    if (wo.z <= 0 || wi.z <= 0) {
+        return 0;
+    }
+    glm::vec3 m = glm::normalize(wo + wi);
+    return ggxD(m, roughness) * ggxG2(wo, wi, roughness) / (4 * wo.z);
+}
 
-const bool Dielectric::scatter(const Ray& in,
-                               const glm::vec3& intersection,
-                               const glm::vec3& normal,
-                               const bool inside,
-                               Ray& out,
-                               Color& outColor,
-                               double& pdf) const {
+Dielectric::Dielectric(const float ior, const float roughness) : ior(ior), roughness(roughness) {}
+
+ScatterRecord Dielectric::scatter(const Ray& in,
+                                  const glm::vec3& intersection,
+                                  const glm::vec3& normal,
+                                  const bool inside) const {
+    STATS_COUNT(DielectricSamples);
+    STATS_TIME(DielectricScatter);
+    ScatterRecord record;
+    float eta = inside ? ior : 1.0 / ior;
+    
+    if (roughness >= kSpecularRoughness) {
+        // work relative to the side of the surface the ray arrived from so the same lobe handles entering and exiting
+        glm::vec3 facingNormal = inside ? -normal : normal;
+        glm::mat3 localBasis = localCoordSystem(facingNormal);
+        glm::vec3 wo = glm::transpose(localBasis) * -in.direction;
+        if (wo.z <= 0) {
+            return record;
+        }
+        
+        glm::vec3 m = sampleGGXVisibleNormal(wo, roughness);
+        float cosThetaM = glm::dot(wo, m);
+        float sinThetaM = sqrt(fmax(0.0, 1 - cosThetaM * cosThetaM));
+        float reflectance = sinThetaM * eta > 1.0 ? 1.0 : schlickReflectance(cosThetaM, eta);
+        
+        // choosing reflection vs. refraction proportionally to the Fresnel term cancels it from the estimator
+        glm::vec3 wi;
+        if (randomFloat(0.0f, 1.0f) < reflectance) {
+            wi = glm::reflect(-wo, m);
+            if (wi.z <= 0) {
+                return record;
+            }
+            record.pdf = reflectance * ggxVisibleNormalPDF(wo, m, roughness) / (4 * cosThetaM);
+        } else {
+            wi = glm::refract(-wo, m, eta);
+            if (wi.z >= 0) {
+                return record;
+            }
+            float denom = cosThetaM + glm::dot(wi, m) / eta;
+            float jacobian = fabs(glm::dot(wi, m)) / (eta * eta * denom * denom);
+            record.pdf = (1 - reflectance) * ggxVisibleNormalPDF(wo, m, roughness) * jacobian;
+        }
+        
+        record.out = Ray(glm::normalize(localBasis * wi), intersection);
+        record.color = WHITE;
+        record.didScatter = record.pdf > 0;
+        return record;
+    }
+    
     float cosTheta = fmin(glm::dot(-in.direction, normal), 1.0);
     float sinTheta = sqrt(1 - cosTheta * cosTheta);
     
-    float eta = inside ? ior : 1.0 / ior;
-    
     // Schlick's approximation to determine whether we want to reflect or refract
-    float r0 = (1 - eta) / (1 + eta);
-    float r02 = r0 * r0;
-    float rTheta = r02 + (1 - r02) * pow((1 - cosTheta), 5.0);
-    float random = glm::linearRand(0.0f, 1.0f);
+    float rTheta = schlickReflectance(cosTheta, eta);
+    float random = randomFloat(0.0f, 1.0f);
     
     bool doReflection = sinTheta * eta > 1.0 || random < rTheta;
     glm::vec3 outDirection = doReflection
         ? glm::reflect(in.direction, normal)
         : glm::refract(in.direction, normal, eta);
-    out = Ray(outDirection, intersection);
-    outColor = WHITE;
-    pdf = scatterPDF(in.direction, outDirection);
-    return true;
+    record.out = Ray(outDirection, intersection);
+    record.color = WHITE;
+    record.pdf = scatterPDF(in, normal, outDirection);
+    record.didScatter = true;
+    return record;
 }
 
-double Dielectric::scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const {
-    return 0;
+Color Dielectric::emit(const glm::vec3& /* intersection */, const glm::vec3& /* normal */) const {
+    return Color(0, 0, 0);
+}
+
+// f * |cos(theta_i)| of the rough BSDF, covering both the reflected and transmitted halves
+float Dielectric::scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const {
+    if (roughness < kSpecularRoughness) {
+        return 0;
+    }
+    
+    bool inside = glm::dot(in.direction, normal) > 0;
+    float eta = inside ? ior : 1.0 / ior;
+    glm::mat3 worldToLocal = glm::transpose(localCoordSystem(inside ? -normal : normal));
+    glm::vec3 wo = worldToLocal * -in.direction;
+    glm::vec3 wi = worldToLocal * glm::normalize(outDirection);
+    if (wo.z <= 0 || wi.z == 0) {
+        return 0;
+    }
+    
+    bool reflected = wi.z > 0;
+    glm::vec3 m = reflected ? glm::normalize(wo + wi) : glm::normalize(-(wo + wi / eta));
+    if (m.z < 0) {
+        m = -m;
+    }
+    float cosThetaM = glm::dot(wo, m);
+    // a valid microfacet must face the viewer and, for refraction, have the outgoing ray leave through it
+    if (cosThetaM <= 0 || (!reflected && glm::dot(wi, m) >= 0)) {
+        return 0;
+    }
+    float sinThetaM = sqrt(fmax(0.0, 1 - cosThetaM * cosThetaM));
+    float reflectance = sinThetaM * eta > 1.0 ? 1.0 : schlickReflectance(cosThetaM, eta);
+    float dg = ggxD(m, roughness) * ggxG2(wo, wi, roughness);
+    
+    if (reflected) {
+        return reflectance * dg / (4 * wo.z);
+    }
+    float denom = cosThetaM + glm::dot(wi, m) / eta;
+    return (1 - reflectance) * dg * cosThetaM * fabs(glm::dot(wi, m)) / (eta * eta * denom * denom * wo.z);
 }
 
 Light::Light(const Color& texture) : texture(texture) {}
 
-const bool Light::scatter(const Ray& in,
-                          const glm::vec3& intersection,
-                          const glm::vec3& normal,
-                          const bool inside,
-                          Ray& out,
-                          Color& outColor,
-                          double& pdf) const {
-    return false; // light sources do not have scattering effects
+ScatterRecord Light::scatter(const Ray& /* in */,
+                             const glm::vec3& /* intersection */,
+                             const glm::vec3& /* normal */,
+                             const bool /* inside */) const {
+    STATS_COUNT(LightSamples);
+    STATS_TIME(LightScatter);
+    return ScatterRecord(); // light sources do not have scattering effects
 }
 
-Color Light::emit(const glm::vec3& intersection, const glm::vec3& normal) const {
+Color Light::emit(const glm::vec3& /* intersection */, const glm::vec3& normal) const {
     // TODO: hard-coded normal for unidirectional light forces lights to all be y axis aligned
     if (normal.y < 0) {
         return Color(0, 0, 0);
@@ -290,6 +532,45 @@ Color Light::emit(const glm::vec3& intersection, const glm::vec3& normal) const
     return texture;
 }
 
-double Light::scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const {
+float Light::scatterPDF(const Ray& /* in */, const glm::vec3& /* normal */, const glm::vec3& /* outDirection */) const {
     return 0;
 }
+
+/**
+ * Material dispatch
+ *
+ * A switch over the closed set of materials (rather than std::visit, which some standard libraries implement as a
+ * table of function pointers) so that, with the member functions defined above in this same translation unit, each
+ * case inlines the BSDF code directly
+ *
+ */
+template <typename F>
+auto visitMaterial(const Material& material, F&& f) {
+    switch (materialType(material)) {
+        case MaterialType::Lambertian:
+            return f(*std::get_if<Lambertian>(&material));
+        case MaterialType::Metal:
+            return f(*std::get_if<Metal>(&material));
+        case MaterialType::Dielectric:
+            return f(*std::get_if<Dielectric>(&material));
+        case MaterialType::Light:
+            break;
+    }
+    return f(*std::get_if<Light>(&material));
+}
+
+ScatterRecord scatter(const Material& material,
+                      const Ray& in,
+                      const glm::vec3& intersection,
+                      const glm::vec3& normal,
+                      const bool inside) {
+    return visitMaterial(material, [&](const auto& m) { return m.scatter(in, intersection, normal, inside); });
+}
+
+Color emit(const Material& material, const glm::vec3& intersection, const glm::vec3& normal) {
+    return visitMaterial(material, [&](const auto& m) { return m.emit(intersection, normal); });
+}
+
+float scatterPDF(const Material& material, const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) {
+    return visitMaterial(material, [&](const auto& m) { return m.scatterPDF(in, normal, outDirection); });
+}
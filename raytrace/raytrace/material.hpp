@@ -11,6 +11,8 @@
 
 #include "util.hpp"
 
+#include <variant>
+
 #define WHITE Color(1.00, 1.00, 1.00)
 #define SILVER Color(.75, .75, .75)
 #define GRAY Color(.40, .40, .40)
@@ -31,87 +33,110 @@
 #define LIGHT_GRAY Color(0.8, 0.8, 0.8)
 #define BEIGE Color(0.8, 0.6, 0.2)
 
-// materials are characterized by their BRDF/BDTF, so these abstract methods are left to implementations
-struct Material {
-    // returns whether or not a scatter happened (could have been absorbed) and populates out ray/color if so
-    virtual const bool scatter(const Ray& in,
-                               const glm::vec3& intersection,
-                               const glm::vec3& normal,
-                               const bool inside,
-                               Ray& out,
-                               Color& outColor,
-                               double& pdf) const = 0;
-    
-    virtual Color emit(const glm::vec3& intersection, const glm::vec3& normal) const {
-        return Color(0, 0, 0);
-    }
-    
-    virtual double scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const {
-        return 0;
-    }
+// outcome of sampling a material's BRDF/BTDF for an incoming ray
+struct ScatterRecord {
+    bool didScatter = false; // false if the ray was absorbed, in which case nothing else is populated
+    Ray out;
+    Color color;
+    float pdf = 0.0; // density of having sampled out. 0 marks a delta distribution, which castRay does not MIS weight
 };
 
-struct Lambertian : public Material {
-    Lambertian(const Color& texture);
+/**
+ * How Lambertian::scatter splits its samples between the three strategies it mixes: directions towards the ceiling
+ * light, towards the glass ball, and the rest cosine weighted about the normal (alpha and beta in the README)
+ *
+ */
+struct SamplingMixture {
+    float light = 0.5;
+    float sphere = 0.0;
+};
+
+// the mixture's two targeted strategies: towards a uniformly random point on the ceiling light, and uniformly within
+// the cone the glass ball subtends from intersection
+glm::vec3 sampleLightDirection(const glm::vec3& intersection);
+glm::vec3 sampleSphereDirection(const glm::vec3& intersection);
+
+/**
+ * Materials are characterized by their BRDF/BDTF, so each implements:
+ *
+ *   scatter:    samples an outgoing ray (see ScatterRecord)
+ *   emit:       emitted radiance at the intersection
+ *   scatterPDF: the (cosine-weighted) scattering distribution for in -> outDirection. a return of 0 is reserved
+ *               for delta distributions (perfect mirrors/glass), in which case castRay skips MIS weighting
+ *
+ * The set of materials is closed (see Material below), so these are plain member functions that get dispatched
+ * at compile time rather than through a vtable
+ *
+ */
+struct Lambertian {
+    Lambertian(const Color& texture, const SamplingMixture& mixture = SamplingMixture());
     
-    const bool scatter(const Ray& in,
-                       const glm::vec3& intersection,
-                       const glm::vec3& normal,
-                       const bool inside,
-                       Ray& out,
-                       Color& outColor,
-                       double& pdf) const override;
-    double scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const override;
+    ScatterRecord scatter(const Ray& in, const glm::vec3& intersection, const glm::vec3& normal, const bool inside) const;
+    Color emit(const glm::vec3& intersection, const glm::vec3& normal) const;
+    float scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const;
     
     Color texture;
+    SamplingMixture mixture;
 };
 
-struct Metal : public Material {
+// rough conductor modelled with a GGX microfacet BRDF, where texture acts as the normal incidence reflectance
+// (Schlick F0) and roughness is the GGX alpha (0 degenerates to a perfect mirror of color texture at every angle)
+struct Metal {
     Metal(const Color& texture, float roughness);
     
-    const bool scatter(const Ray& in,
-                       const glm::vec3& intersection,
-                       const glm::vec3& normal,
-                       const bool inside,
-                       Ray& out,
-                       Color& outColor,
-                       double& pdf) const override;
-    double scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const override;
+    ScatterRecord scatter(const Ray& in, const glm::vec3& intersection, const glm::vec3& normal, const bool inside) const;
+    Color emit(const glm::vec3& intersection, const glm::vec3& normal) const;
+    float scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const;
     
     Color texture;
     float roughness;
 };
 
-struct Dielectric : public Material {
-    Dielectric(const float ior);
+// glass-like material: smooth by default, or a GGX microfacet BSDF (Walter et al. 2007) when roughness > 0
+struct Dielectric {
+    Dielectric(const float ior, const float roughness = 0.0);
     
-    const bool scatter(const Ray& in,
-                       const glm::vec3& intersection,
-                       const glm::vec3& normal,
-                       const bool inside,
-                       Ray& out,
-                       Color& outColor,
-                       double& pdf) const override;
-    double scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const override;
+    ScatterRecord scatter(const Ray& in, const glm::vec3& intersection, const glm::vec3& normal, const bool inside) const;
+    Color emit(const glm::vec3& intersection, const glm::vec3& normal) const;
+    float scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const;
     
     float ior;
+    float roughness;
 };
 
-struct Light : public Material {
+struct Light {
     Light(const Color& texture);
     
-    const bool scatter(const Ray& in,
-                       const glm::vec3& intersection,
-                       const glm::vec3& normal,
-                       const bool inside,
-                       Ray& out,
-                       Color& outColor,
-                       double& pdf) const override;
-    double scatterPDF(const glm::vec3& normal, const glm::vec3& outDirection) const override;
-    
-    Color emit(const glm::vec3& intersection, const glm::vec3& normal) const override;
+    ScatterRecord scatter(const Ray& in, const glm::vec3& intersection, const glm::vec3& normal, const bool inside) const;
+    Color emit(const glm::vec3& intersection, const glm::vec3& normal) const;
+    float scatterPDF(const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection) const;
 
     Color texture;
 };
 
+using Material = std::variant<Lambertian, Metal, Dielectric, Light>;
+
+// the concrete kinds of material, in the same order as the alternatives of Material
+enum class MaterialType {
+    Lambertian,
+    Metal,
+    Dielectric,
+    Light,
+};
+
+const int kNumMaterialTypes = static_cast<int>(std::variant_size<Material>::value);
+
+inline MaterialType materialType(const Material& material) {
+    return static_cast<MaterialType>(material.index());
+}
+
+// dispatch to whichever material is held. these live in material.cpp so that the member bodies inline into them
+ScatterRecord scatter(const Material& material,
+                      const Ray& in,
+                      const glm::vec3& intersection,
+                      const glm::vec3& normal,
+                      const bool inside);
+Color emit(const Material& material, const glm::vec3& intersection, const glm::vec3& normal);
+float scatterPDF(const Material& material, const Ray& in, const glm::vec3& normal, const glm::vec3& outDirection);
+
 #endif /* material_hpp */
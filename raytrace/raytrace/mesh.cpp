@@ -0,0 +1,457 @@
+/**
+ * @file mesh.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "mesh.hpp"
+
+#include "bvh.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static_assert(sizeof(MeshFileHeader) == 72, "mesh file header layout changed");
+static_assert(sizeof(MeshNode) == 32, "mesh node layout changed");
+static_assert(sizeof(MeshVertex) == 6, "mesh vertex layout changed");
+static_assert(sizeof(MeshTriangle) == 12, "mesh triangle layout changed");
+
+// arrays in mesh files start on cache line boundaries
+const uint64_t kMeshArrayAlignment = 64;
+
+// hits closer than this are the surface the ray just left, re-found through rounding
+const float kMinTriangleDistance = 1e-4;
+
+const uint16_t kQuantizationSteps = 65535;
+
+// handed out to meshes as they load, starting from 1 so that no mesh matches an empty MeshHit
+std::atomic<uint64_t> nextMeshId(1);
+
+/**
+ * the triangle the calling thread's last hit on a mesh was on, for normal to pick up. castRay and the wavefront
+ * integrator both ask for the normal right after the closest hit is found, and a ray tests each object at most once
+ * along the way, so for a scene with one mesh this is always the hit being shaded
+ *
+ */
+struct MeshHit {
+    uint64_t mesh = 0;
+    glm::vec3 point;
+    uint32_t triangle = 0;
+};
+
+thread_local MeshHit lastMeshHit;
+
+MappedFile::~MappedFile() {
+    if (data) {
+        munmap(const_cast<uint8_t*>(data), size);
+    }
+}
+
+// shared by the packer and the renderer, so that both see exactly the same vertices
+glm::vec3 dequantize(const MeshVertex& vertex, const glm::vec3& quantizationMin, const glm::vec3& quantizationScale) {
+    return quantizationMin + glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]) * quantizationScale;
+}
+
+glm::vec3 Mesh::vertex(uint32_t index) const {
+    return dequantize(vertices[index], quantizationMin, quantizationScale);
+}
+
+/**
+ * inner nodes need both children in the array and after themselves, so that traversal only ever moves forward (and
+ * so ends), and room on the stack for the child it puts off. leaves need their triangles in the array
+ *
+ */
+bool Mesh::validNode(const MeshNode& node, uint32_t index, int stackSize) {
+    const bool valid = node.count > 0 ?
+        static_cast<uint64_t>(node.secondChildOrFirst) + node.count <= header->numTriangles :
+        index + 1 < header->numNodes && node.secondChildOrFirst > index + 1 &&
+        node.secondChildOrFirst < header->numNodes && stackSize < kMaxBVHDepth;
+    if (!valid) {
+        reportCorruption();
+    }
+    return valid;
+}
+
+bool Mesh::validTriangle(const MeshTriangle& triangle) {
+    const bool valid = triangle.vertex[0] < header->numVertices && triangle.vertex[1] < header->numVertices &&
+                       triangle.vertex[2] < header->numVertices;
+    if (!valid) {
+        reportCorruption();
+    }
+    return valid;
+}
+
+void Mesh::reportCorruption() {
+    if (!reportedCorruption.exchange(true)) {
+        std::cerr << filename << " is corrupt, rendering it without the parts that index out of range" << std::endl;
+    }
+}
+
+Bounds nodeBounds(const MeshNode& node) {
+    Bounds bounds;
+    bounds.min = glm::vec3(node.boundsMin[0], node.boundsMin[1], node.boundsMin[2]);
+    bounds.max = glm::vec3(node.boundsMax[0], node.boundsMax[1], node.boundsMax[2]);
+    return bounds;
+}
+
+// Moller-Trumbore: solves for the hit's distance and barycentric coordinates at once
+float intersectTriangle(const Ray& ray, const glm::vec3& a, const glm::vec3& b, const glm::vec3& c) {
+    STATS_COUNT(TriangleTests);
+    const glm::vec3 edge1 = b - a;
+    const glm::vec3 edge2 = c - a;
+    const glm::vec3 p = glm::cross(ray.direction, edge2);
+    const float determinant = glm::dot(edge1, p);
+    if (determinant == 0) {
+        return -1.0; // parallel to the triangle
+    }
+    const float inverseDeterminant = 1 / determinant;
+    
+    const glm::vec3 s = ray.origin - a;
+    const float u = glm::dot(s, p) * inverseDeterminant;
+    if (u < 0 || u > 1) {
+        return -1.0;
+    }
+    const glm::vec3 q = glm::cross(s, edge1);
+    const float v = glm::dot(ray.direction, q) * inverseDeterminant;
+    if (v < 0 || u + v > 1) {
+        return -1.0;
+    }
+    return glm::dot(edge2, q) * inverseDeterminant;
+}
+
+float Mesh::intersect(const Ray& ray, glm::vec3& intersection) {
+    STATS_TIME(MeshIntersect);
+    if (header->numNodes == 0) {
+        return -1.0;
+    }
+    
+    Ray localRay = ray;
+    localRay.origin -= offset;
+    const glm::vec3 inverseDirection = 1.0f / localRay.direction;
+    float closestIntersection = std::numeric_limits<float>::max();
+    uint32_t closestTriangle = 0;
+    
+    if (nodeBounds(nodes[0]).intersect(localRay, inverseDirection, closestIntersection) < 0) {
+        return -1.0;
+    }
+    
+    // same traversal as BVH::intersect, straight off the mapped nodes
+    uint32_t stack[kMaxBVHDepth];
+    float stackDistance[kMaxBVHDepth];
+    int stackSize = 0;
+    uint32_t index = 0;
+    while (true) {
+        STATS_COUNT(BVHNodes);
+        const MeshNode& node = nodes[index];
+        if (!validNode(node, index, stackSize)) {
+            // left out, as if empty
+        } else if (node.count > 0) {
+            for (uint32_t i = node.secondChildOrFirst; i < node.secondChildOrFirst + node.count; i++) {
+                const MeshTriangle& triangle = triangles[i];
+                if (!validTriangle(triangle)) {
+                    continue;
+                }
+                float t = intersectTriangle(localRay, vertex(triangle.vertex[0]), vertex(triangle.vertex[1]),
+                                            vertex(triangle.vertex[2]));
+                if (t > kMinTriangleDistance && t < closestIntersection) {
+                    closestIntersection = t;
+                    closestTriangle = i;
+                }
+            }
+        } else {
+            uint32_t near = index + 1;
+            uint32_t far = node.secondChildOrFirst;
+            float nearDistance = nodeBounds(nodes[near]).intersect(localRay, inverseDirection, closestIntersection);
+            float farDistance = nodeBounds(nodes[far]).intersect(localRay, inverseDirection, closestIntersection);
+            if (farDistance >= 0 && (nearDistance < 0 || farDistance < nearDistance)) {
+                std::swap(near, far);
+                std::swap(nearDistance, farDistance);
+            }
+            if (nearDistance >= 0) {
+                if (farDistance >= 0) {
+                    stack[stackSize] = far;
+                    stackDistance[stackSize++] = farDistance;
+                }
+                index = near;
+                continue;
+            }
+        }
+        
+        // next node off the stack, skipping any that a closer hit has since ruled out
+        while (stackSize > 0 && stackDistance[stackSize - 1] > closestIntersection) {
+            stackSize--;
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    
+    if (closestIntersection == std::numeric_limits<float>::max()) {
+        return -1.0;
+    }
+    intersection = ray.origin + closestIntersection * ray.direction;
+    lastMeshHit.mesh = id;
+    lastMeshHit.point = intersection;
+    lastMeshHit.triangle = closestTriangle;
+    return closestIntersection;
+}
+
+glm::vec3 Mesh::normal(const glm::vec3& intersectionPoint) {
+    if (lastMeshHit.mesh == id && lastMeshHit.point == intersectionPoint) {
+        // never degenerate, since intersectTriangle misses those
+        const MeshTriangle& triangle = triangles[lastMeshHit.triangle];
+        const glm::vec3 a = vertex(triangle.vertex[0]);
+        return glm::normalize(glm::cross(vertex(triangle.vertex[1]) - a, vertex(triangle.vertex[2]) - a));
+    }
+    
+    // otherwise (another mesh was hit since), the triangle is recovered from the point, like Box's side: of the
+    // triangles whose boxes hold the point, it is the one whose plane it lies closest to
+    const glm::vec3 point = intersectionPoint - offset;
+    const glm::vec3 magnitude = glm::abs(point);
+    const glm::vec3 step = quantizationScale;
+    const float tolerance = std::max(std::max(step.x, std::max(step.y, step.z)),
+                                     1e-4f * std::max(1.0f, std::max(magnitude.x, std::max(magnitude.y, magnitude.z))));
+    
+    glm::vec3 closestNormal(0, 1, 0);
+    float closestDistance = std::numeric_limits<float>::max();
+    uint32_t stack[kMaxBVHDepth];
+    int stackSize = 0;
+    uint32_t index = 0;
+    while (header->numNodes > 0) {
+        const MeshNode& node = nodes[index];
+        bool contains = validNode(node, index, stackSize);
+        for (int axis = 0; axis < 3; axis++) {
+            contains &= node.boundsMin[axis] - tolerance <= point[axis] &&
+                        point[axis] <= node.boundsMax[axis] + tolerance;
+        }
+        if (contains && node.count == 0) {
+            stack[stackSize++] = node.secondChildOrFirst;
+            index++;
+            continue;
+        }
+        if (contains) {
+            for (uint32_t i = node.secondChildOrFirst; i < node.secondChildOrFirst + node.count; i++) {
+                const MeshTriangle& triangle = triangles[i];
+                if (!validTriangle(triangle)) {
+                    continue;
+                }
+                const glm::vec3 a = vertex(triangle.vertex[0]);
+                const glm::vec3 edge1 = vertex(triangle.vertex[1]) - a;
+                const glm::vec3 edge2 = vertex(triangle.vertex[2]) - a;
+                const glm::vec3 normal = glm::cross(edge1, edge2);
+                if (glm::dot(normal, normal) == 0) {
+                    continue; // degenerate
+                }
+                const glm::vec3 unitNormal = glm::normalize(normal);
+                const float distance = std::fabs(glm::dot(point - a, unitNormal));
+                
+                // barycentric coordinates of the point projected onto the triangle, to check that it is inside
+                const glm::vec3 toPoint = point - a;
+                const float d00 = glm::dot(edge1, edge1), d01 = glm::dot(edge1, edge2), d11 = glm::dot(edge2, edge2);
+                const float d20 = glm::dot(toPoint, edge1), d21 = glm::dot(toPoint, edge2);
+                const float denominator = d00 * d11 - d01 * d01;
+                const float v = (d11 * d20 - d01 * d21) / denominator;
+                const float w = (d00 * d21 - d01 * d20) / denominator;
+                const float kInsideTolerance = 1e-3;
+                if (v >= -kInsideTolerance && w >= -kInsideTolerance && v + w <= 1 + kInsideTolerance &&
+                    distance < closestDistance) {
+                    closestDistance = distance;
+                    closestNormal = unitNormal;
+                }
+            }
+        }
+        if (stackSize == 0) {
+            break;
+        }
+        index = stack[--stackSize];
+    }
+    return closestNormal;
+}
+
+Bounds Mesh::bounds() {
+    if (header->numNodes == 0) {
+        return Bounds();
+    }
+    Bounds bounds = nodeBounds(nodes[0]);
+    bounds.min += offset;
+    bounds.max += offset;
+    return bounds;
+}
+
+void Mesh::translate(const glm::vec3& offset) {
+    this->offset += offset;
+}
+
+// whether count elements of T starting offset bytes in fit in a file of size bytes, suitably aligned
+template <typename T>
+bool arrayFits(uint64_t offset, uint64_t count, size_t size) {
+    return offset % alignof(T) == 0 && offset <= size && count <= (size - offset) / sizeof(T);
+}
+
+Mesh* loadMesh(Arena& arena, const std::string& filename, Material* material, std::string& error) {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error = "could not open " + filename;
+        return nullptr;
+    }
+    struct stat status;
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (fstat(fd, &status) == 0 && status.st_size > 0) {
+        void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            file->data = static_cast<const uint8_t*>(data);
+            file->size = status.st_size;
+        }
+    }
+    close(fd); // the mapping keeps the file itself alive
+    if (!file->data) {
+        error = "could not map " + filename;
+        return nullptr;
+    }
+    
+    const MeshFileHeader* header = reinterpret_cast<const MeshFileHeader*>(file->data);
+    if (file->size < sizeof(MeshFileHeader) || std::memcmp(header->magic, kMeshMagic, sizeof(kMeshMagic)) != 0) {
+        error = filename + " is not a packed mesh (see raytrace_meshpack)";
+        return nullptr;
+    }
+    if (header->byteOrderMark != kMeshByteOrderMark) {
+        error = filename + " was packed on a machine of the other byte order, or by an older raytrace_meshpack " +
+                "(repack it)";
+        return nullptr;
+    }
+    if (header->version != kMeshVersion) {
+        error = filename + " is version " + std::to_string(header->version) + " of the mesh format, not " +
+                std::to_string(kMeshVersion) + " (repack it)";
+        return nullptr;
+    }
+    if (!arrayFits<MeshVertex>(header->verticesOffset, header->numVertices, file->size) ||
+        !arrayFits<MeshTriangle>(header->trianglesOffset, header->numTriangles, file->size) ||
+        !arrayFits<MeshNode>(header->nodesOffset, header->numNodes, file->size) ||
+        (header->numTriangles > 0 && header->numNodes == 0)) {
+        error = filename + " is truncated or corrupt";
+        return nullptr;
+    }
+    
+    Mesh* mesh = arena.make<Mesh>();
+    mesh->material = material;
+    mesh->file = file;
+    mesh->header = header;
+    mesh->vertices = reinterpret_cast<const MeshVertex*>(file->data + header->verticesOffset);
+    mesh->triangles = reinterpret_cast<const MeshTriangle*>(file->data + header->trianglesOffset);
+    mesh->nodes = reinterpret_cast<const MeshNode*>(file->data + header->nodesOffset);
+    mesh->quantizationMin = glm::vec3(header->boundsMin[0], header->boundsMin[1], header->boundsMin[2]);
+    mesh->quantizationScale = (glm::vec3(header->boundsMax[0], header->boundsMax[1], header->boundsMax[2]) -
+                               mesh->quantizationMin) / static_cast<float>(kQuantizationSteps);
+    mesh->offset = glm::vec3(0, 0, 0);
+    mesh->id = nextMeshId++;
+    mesh->filename = filename;
+    mesh->reportedCorruption = false;
+    return mesh;
+}
+
+void writePadding(std::ofstream& out) {
+    while (static_cast<uint64_t>(out.tellp()) % kMeshArrayAlignment != 0) {
+        out.put(0);
+    }
+}
+
+bool writeMesh(const std::string& filename,
+               const std::vector<glm::vec3>& positions,
+               const std::vector<MeshTriangle>& triangles) {
+    MeshFileHeader header = {};
+    std::memcpy(header.magic, kMeshMagic, sizeof(kMeshMagic));
+    header.byteOrderMark = kMeshByteOrderMark;
+    header.version = kMeshVersion;
+    
+    Bounds extent;
+    for (const glm::vec3& position : positions) {
+        extent.extend(position);
+    }
+    if (positions.empty()) {
+        extent.min = extent.max = glm::vec3(0, 0, 0);
+    }
+    const glm::vec3 quantizationScale = (extent.max - extent.min) / static_cast<float>(kQuantizationSteps);
+    for (int axis = 0; axis < 3; axis++) {
+        header.boundsMin[axis] = extent.min[axis];
+        header.boundsMax[axis] = extent.max[axis];
+    }
+    
+    std::vector<MeshVertex> quantized(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        for (int axis = 0; axis < 3; axis++) {
+            const float step = quantizationScale[axis];
+            const float q = step > 0 ? std::round((positions[i][axis] - extent.min[axis]) / step) : 0;
+            quantized[i].position[axis] = static_cast<uint16_t>(std::min<float>(std::max(q, 0.0f), kQuantizationSteps));
+        }
+    }
+    
+    // the BVH is built over the quantized triangles, since those are what rays will be tested against
+    std::vector<Bounds> triangleBounds(triangles.size());
+    for (size_t i = 0; i < triangles.size(); i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            triangleBounds[i].extend(dequantize(quantized[triangles[i].vertex[corner]], extent.min, quantizationScale));
+        }
+        triangleBounds[i] = padBounds(triangleBounds[i]);
+    }
+    BVH bvh;
+    bvh.build(triangleBounds);
+    
+    std::vector<MeshNode> nodes(bvh.nodes.size());
+    for (size_t i = 0; i < bvh.nodes.size(); i++) {
+        const BVHNode& node = bvh.nodes[i];
+        for (int axis = 0; axis < 3; axis++) {
+            nodes[i].boundsMin[axis] = node.bounds.min[axis];
+            nodes[i].boundsMax[axis] = node.bounds.max[axis];
+        }
+        nodes[i].secondChildOrFirst = node.count > 0 ? node.first : node.secondChild;
+        nodes[i].count = node.count;
+    }
+    
+    std::vector<MeshTriangle> orderedTriangles(triangles.size());
+    std::vector<MeshVertex> orderedVertices;
+    std::vector<int64_t> vertexIndex(positions.size(), -1);
+    for (size_t i = 0; i < triangles.size(); i++) {
+        for (int corner = 0; corner < 3; corner++) {
+            const uint32_t original = triangles[bvh.primitives[i]].vertex[corner];
+            if (vertexIndex[original] < 0) {
+                vertexIndex[original] = orderedVertices.size();
+                orderedVertices.push_back(quantized[original]);
+            }
+            orderedTriangles[i].vertex[corner] = static_cast<uint32_t>(vertexIndex[original]);
+        }
+    }
+    
+    header.numVertices = static_cast<uint32_t>(orderedVertices.size());
+    header.numTriangles = static_cast<uint32_t>(orderedTriangles.size());
+    header.numNodes = static_cast<uint32_t>(nodes.size());
+    
+    std::ofstream out(filename, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    writePadding(out);
+    header.verticesOffset = out.tellp();
+    out.write(reinterpret_cast<const char*>(orderedVertices.data()), orderedVertices.size() * sizeof(MeshVertex));
+    writePadding(out);
+    header.trianglesOffset = out.tellp();
+    out.write(reinterpret_cast<const char*>(orderedTriangles.data()), orderedTriangles.size() * sizeof(MeshTriangle));
+    writePadding(out);
+    header.nodesOffset = out.tellp();
+    out.write(reinterpret_cast<const char*>(nodes.data()), nodes.size() * sizeof(MeshNode));
+    
+    // now that the offsets are known
+    out.seekp(0);
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    return static_cast<bool>(out);
+}
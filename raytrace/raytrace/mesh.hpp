@@ -0,0 +1,136 @@
+/**
+ * @file mesh.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef mesh_hpp
+#define mesh_hpp
+
+#include "arena.hpp"
+#include "geometry.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/* ***********************************************************************
+ * Binary meshes
+ * -----------------------------------------------------------------------
+ * Triangle meshes are packed ahead of time (see tools/meshpack.cpp) into a
+ * file laid out exactly as the renderer traverses it, so loading one is a
+ * single mmap: there is nothing to parse, and pages are only faulted in as
+ * rays reach them. Being clean file-backed pages, the kernel can drop them
+ * again under memory pressure, so meshes larger than RAM still render (if
+ * slowly) rather than running out of memory.
+ *
+ * The file is a header followed by three arrays, each 64 byte aligned:
+ *
+ *   vertices:  uint16 x, y, z quantized over the header's bounds
+ *   triangles: uint32 vertex indices a, b, c (counter-clockwise seen from
+ *              the front), ordered so that every BVH leaf is a contiguous
+ *              range
+ *   nodes:     the mesh's BVH (as in bvh.hpp: depth first, a node's first
+ *              child follows it), with float bounds
+ *
+ * All of it is in the byte order of the machine that packed it, which the
+ * header records (along with the format's version) so that loadMesh rejects
+ * files from a machine of the other byte order rather than misreading them.
+ * loadMesh also checks that the arrays fit in the file, but reads nothing
+ * past the header. Everything else is checked as traversal reaches it:
+ * nodes whose children are out of range (or not after them, which could
+ * loop), leaves and triangles indexing past the end of their arrays, and
+ * trees deeper than the traversal stack are all treated as empty, and
+ * reported once per mesh.
+ * *********************************************************************** */
+
+const char kMeshMagic[8] = { 'R', 'T', 'M', 'E', 'S', 'H', '1', '\0' };
+
+// written as is, so it reads back as 0x0201 on a machine of the other byte order
+const uint16_t kMeshByteOrderMark = 0x0102;
+const uint16_t kMeshVersion = 1;
+
+struct MeshFileHeader {
+    char magic[8];
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t numNodes;
+    uint16_t byteOrderMark;
+    uint16_t version;
+    float boundsMin[3]; // the box vertices are quantized over
+    float boundsMax[3];
+    uint64_t verticesOffset; // byte offsets of the arrays from the start of the file
+    uint64_t trianglesOffset;
+    uint64_t nodesOffset;
+};
+
+struct MeshNode {
+    float boundsMin[3];
+    float boundsMax[3];
+    uint32_t secondChildOrFirst; // second child of inner nodes, first triangle of leaves
+    uint32_t count; // triangles in leaves, 0 for inner nodes
+};
+
+struct MeshVertex {
+    uint16_t position[3];
+};
+
+struct MeshTriangle {
+    uint32_t vertex[3];
+};
+
+// read only mapping of a whole file, unmapped once the last mesh using it is gone
+struct MappedFile {
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+    
+    MappedFile() {}
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+};
+
+struct Mesh : public Geometry {
+    std::shared_ptr<MappedFile> file;
+    const MeshFileHeader* header;
+    const MeshVertex* vertices;
+    const MeshTriangle* triangles;
+    const MeshNode* nodes;
+    glm::vec3 quantizationMin;
+    glm::vec3 quantizationScale;
+    glm::vec3 offset; // from translate, since the file itself cannot move
+    uint64_t id; // unique to this load of the file, so that hits recorded by intersect are never mistaken for another's
+    std::string filename;
+    std::atomic<bool> reportedCorruption;
+    
+    float intersect(const Ray& ray, glm::vec3& intersection) override;
+    glm::vec3 normal(const glm::vec3& intersectionPoint) override;
+    Bounds bounds() override;
+    void translate(const glm::vec3& offset) override;
+    
+    glm::vec3 vertex(uint32_t index) const; // in the mesh's own (untranslated) space
+    
+    // whether traversal can follow node, at index and with stackSize nodes waiting on its stack, without leaving the
+    // arrays or its stack. the mesh is reported corrupt if not
+    bool validNode(const MeshNode& node, uint32_t index, int stackSize);
+    bool validTriangle(const MeshTriangle& triangle);
+    void reportCorruption();
+};
+
+// maps a packed mesh file into a Mesh made in arena, returning nullptr (with the reason in error) if it is not one
+Mesh* loadMesh(Arena& arena, const std::string& filename, Material* material, std::string& error);
+
+/**
+ * quantizes and packs a triangle mesh into filename. triangles are reordered along with the BVH built over them, and
+ * vertices by first use in that order, so that rays through one part of the mesh touch as few pages as possible
+ *
+ */
+bool writeMesh(const std::string& filename,
+               const std::vector<glm::vec3>& positions,
+               const std::vector<MeshTriangle>& triangles);
+
+#endif /* mesh_hpp */
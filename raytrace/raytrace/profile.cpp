@@ -0,0 +1,58 @@
+/**
+ * @file profile.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "profile.hpp"
+
+#include "image.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+
+void RenderProfile::reset(int numPixels) {
+    pixelSeconds.assign(numPixels, 0.0);
+    pixelTests.assign(numPixels, 0.0);
+    tileEvents.clear();
+}
+
+// piecewise linear ramp through black, red, yellow and white for t in [0, 1]
+Color heatColor(float t) {
+    t = std::min(std::max(t, 0.0f), 1.0f) * 3.0f;
+    return Color(std::min(t, 1.0f), std::min(std::max(t - 1.0f, 0.0f), 1.0f), std::max(t - 2.0f, 0.0f));
+}
+
+bool writeHeatmap(const std::string& filename, int width, int height, const std::vector<double>& values) {
+    const float kClipPercentile = 0.99;
+    
+    std::vector<double> sorted(values);
+    std::sort(sorted.begin(), sorted.end());
+    const double clip = sorted.empty() ? 0.0 : sorted[static_cast<size_t>(kClipPercentile * (sorted.size() - 1))];
+    
+    std::vector<Color> pixels(values.size());
+    for (size_t i = 0; i < values.size(); i++) {
+        pixels[i] = heatColor(clip > 0 ? static_cast<float>(values[i] / clip) : 0.0f);
+    }
+    return writePPM(filename, width, height, pixels);
+}
+
+bool writeTimeline(const std::string& filename, const std::vector<TileEvent>& tileEvents) {
+    std::ofstream out(filename);
+    out << std::fixed << std::setprecision(3); // microseconds
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (size_t i = 0; i < tileEvents.size(); i++) {
+        const TileEvent& event = tileEvents[i];
+        out << "  {\"name\": \"tile " << event.tile << "\", \"cat\": \"tile\", \"ph\": \"X\", \"pid\": 0"
+            << ", \"tid\": " << event.thread
+            << ", \"ts\": " << event.start * 1e6 << ", \"dur\": " << (event.end - event.start) * 1e6
+            << ", \"args\": {\"x0\": " << event.x0 << ", \"y0\": " << event.y0
+            << ", \"x1\": " << event.x1 << ", \"y1\": " << event.y1 << "}}"
+            << (i + 1 < tileEvents.size() ? ",\n" : "\n");
+    }
+    out << "]}\n";
+    return static_cast<bool>(out);
+}
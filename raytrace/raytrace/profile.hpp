@@ -0,0 +1,50 @@
+/**
+ * @file profile.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef profile_hpp
+#define profile_hpp
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// one tile as rendered by one thread, with times in seconds since the render started
+struct TileEvent {
+    int thread;
+    size_t tile;
+    int x0, y0, x1, y1;
+    double start;
+    double end;
+};
+
+/**
+ * Optional diagnostics of where a render spends its time, filled in by render() when asked for one:
+ *
+ *   pixelSeconds: wall time spent on each pixel's samples. the wavefront integrator processes many pixels at once,
+ *                 so there each batch's time is split evenly over the paths it advanced
+ *   pixelTests:   primitive intersection tests made for each pixel (split the same way for wavefront). these come
+ *                 from the stats counters, so they are only counted in RAYTRACE_STATS builds
+ *   tileEvents:   which thread rendered which tile and when, to spot load imbalance and stragglers
+ *
+ */
+struct RenderProfile {
+    std::vector<double> pixelSeconds;
+    std::vector<double> pixelTests;
+    std::vector<TileEvent> tileEvents;
+    
+    void reset(int numPixels);
+};
+
+// false colour image of per-pixel values (black -> red -> yellow -> white), clipped at the 99th percentile so a few
+// outliers do not wash out the rest
+bool writeHeatmap(const std::string& filename, int width, int height, const std::vector<double>& values);
+
+// tile events as a Chrome trace (chrome://tracing or https://ui.perfetto.dev), one track per render thread
+bool writeTimeline(const std::string& filename, const std::vector<TileEvent>& tileEvents);
+
+#endif /* profile_hpp */
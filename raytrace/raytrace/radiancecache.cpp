@@ -0,0 +1,77 @@
+/**
+ * @file radiancecache.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "radiancecache.hpp"
+
+#include <cmath>
+
+// samples a cell needs before lookups trust its average over tracing the path further
+const uint32_t kMinCachedSamples = 32;
+
+uint64_t hashCombine(uint64_t hash, uint64_t value) {
+    return hash ^ (value + 0x9e3779b97f4a7c15 + (hash << 6) + (hash >> 2));
+}
+
+uint64_t RadianceCache::cellKey(const Geometry* object, const glm::vec3& point, bool backFacing, int bounce) const {
+    uint64_t key = reinterpret_cast<uintptr_t>(object);
+    key = hashCombine(key, static_cast<int64_t>(std::floor(point.x / cellSize)));
+    key = hashCombine(key, static_cast<int64_t>(std::floor(point.y / cellSize)));
+    key = hashCombine(key, static_cast<int64_t>(std::floor(point.z / cellSize)));
+    key = hashCombine(key, backFacing);
+    return hashCombine(key, bounce);
+}
+
+bool RadianceCache::lookup(const Geometry* object,
+                           const glm::vec3& point,
+                           bool backFacing,
+                           int bounce,
+                           Color& radiance) const {
+    auto cell = cells.find(cellKey(object, point, backFacing, bounce));
+    if (cell == cells.end() || cell->second.object != object || cell->second.bounce != bounce ||
+        cell->second.samples < kMinCachedSamples) {
+        return false;
+    }
+    radiance = cell->second.sum / static_cast<float>(cell->second.samples);
+    return true;
+}
+
+void RadianceCache::record(const Geometry* object,
+                           const glm::vec3& point,
+                           bool backFacing,
+                           int bounce,
+                           const Color& radiance) {
+    const uint64_t key = cellKey(object, point, backFacing, bounce);
+    Stripe& stripe = pending[key % kNumStripes];
+    std::lock_guard<std::mutex> lock(stripe.mutex);
+    auto inserted = stripe.cells.emplace(key, Cell { object, bounce, Color(0, 0, 0), 0 });
+    inserted.first->second.sum += radiance;
+    inserted.first->second.samples++;
+}
+
+void RadianceCache::endFrame() {
+    for (Stripe& stripe : pending) {
+        for (const auto& recorded : stripe.cells) {
+            auto inserted = cells.emplace(recorded.first,
+                                          Cell { recorded.second.object, recorded.second.bounce, Color(0, 0, 0), 0 });
+            inserted.first->second.sum += recorded.second.sum;
+            inserted.first->second.samples += recorded.second.samples;
+        }
+        stripe.cells.clear();
+    }
+}
+
+void RadianceCache::forget(const Geometry* object) {
+    for (auto cell = cells.begin(); cell != cells.end(); ) {
+        cell = cell->second.object == object ? cells.erase(cell) : std::next(cell);
+    }
+    for (Stripe& stripe : pending) {
+        for (auto cell = stripe.cells.begin(); cell != stripe.cells.end(); ) {
+            cell = cell->second.object == object ? stripe.cells.erase(cell) : std::next(cell);
+        }
+    }
+}
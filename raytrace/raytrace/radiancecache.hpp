@@ -0,0 +1,84 @@
+/**
+ * @file radiancecache.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef radiancecache_hpp
+#define radiancecache_hpp
+
+#include "geometry.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+/* ***********************************************************************
+ * Radiance cache
+ * -----------------------------------------------------------------------
+ * Lets an animation reuse the lighting it has already converged in earlier
+ * frames. Light leaving a Lambertian surface looks the same from every
+ * direction, so what castRay returns at a diffuse hit is a (noisy) estimate
+ * of something that does not depend on where the camera is. The cache
+ * averages those estimates over a coarse grid of cells on each object's
+ * surface, and once a cell has seen enough of them, later frames take the
+ * average instead of tracing the rest of the path from there.
+ *
+ * Only hits after the first bounce are cached, since primary hits are what
+ * the image shows directly. What castRay returns also depends on how many
+ * bounces it has left to trace, so each cell is kept per remaining bounce
+ * count, and a lookup only ever sees estimates cut off at the same depth as
+ * its own. Hits with no bounces left are not cached at all: without a
+ * further bounce, a diffuse surface returns nothing. A cell's average only
+ * becomes visible to lookups at the end of the frame (so the first frame is
+ * rendered exactly as without the cache). Cells on objects that move are
+ * forgotten. Cells on static objects are kept, even though a moving object
+ * changes their lighting too (e.g. by shadowing them). That lag in indirect
+ * lighting is the price of the reuse.
+ * *********************************************************************** */
+
+struct RadianceCache {
+    // cells are cubes of this edge length. primaryBounces is the bounce count castRay starts from for camera rays
+    RadianceCache(float cellSize, int primaryBounces) : cellSize(cellSize), primaryBounces(primaryBounces) {}
+    
+    // average radiance leaving object's surface around point (on the side given by backFacing), as traced with bounce
+    // bounces left, over earlier frames, if enough samples have been taken there
+    bool lookup(const Geometry* object, const glm::vec3& point, bool backFacing, int bounce, Color& radiance) const;
+    
+    // adds a sample for lookups from the next frame on. safe to call from any number of render threads at once
+    void record(const Geometry* object, const glm::vec3& point, bool backFacing, int bounce, const Color& radiance);
+    
+    // makes what was recorded during the frame visible to lookups. call it between frames, not while rendering
+    void endFrame();
+    
+    // drops every cell on object, e.g. because it has moved. also only between frames
+    void forget(const Geometry* object);
+    
+    struct Cell {
+        const Geometry* object;
+        int bounce;
+        Color sum;
+        uint32_t samples;
+    };
+    
+    uint64_t cellKey(const Geometry* object, const glm::vec3& point, bool backFacing, int bounce) const;
+    
+    const float cellSize;
+    const int primaryBounces;
+    
+    std::unordered_map<uint64_t, Cell> cells;
+    
+    // this frame's records, spread over several separately locked maps to keep render threads from queueing up
+    static const int kNumStripes = 64;
+    struct Stripe {
+        std::mutex mutex;
+        std::unordered_map<uint64_t, Cell> cells;
+    };
+    std::array<Stripe, kNumStripes> pending;
+};
+
+#endif /* radiancecache_hpp */
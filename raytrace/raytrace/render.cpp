@@ -0,0 +1,343 @@
+/**
+ * @file render.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "render.hpp"
+
+#include "sampling.hpp"
+#include "shadingcache.hpp"
+#include "stats.hpp"
+#include "wavefront.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+bool parseIntegrator(const std::string& name, Integrator& integrator) {
+    if (name == "recursive") {
+        integrator = Integrator::Recursive;
+        return true;
+    }
+    if (name == "wavefront") {
+        integrator = Integrator::Wavefront;
+        return true;
+    }
+    return false;
+}
+
+bool parseSampler(const std::string& name, Sampler& sampler) {
+    if (name == "random") {
+        sampler = Sampler::Random;
+        return true;
+    }
+    if (name == "stratified") {
+        sampler = Sampler::Stratified;
+        return true;
+    }
+    return false;
+}
+
+bool parseShardMode(const std::string& name, ShardMode& mode) {
+    if (name == "tiles") {
+        mode = ShardMode::Tiles;
+        return true;
+    }
+    if (name == "samples") {
+        mode = ShardMode::Samples;
+        return true;
+    }
+    return false;
+}
+
+bool parseShard(const std::string& spec, Shard& shard) {
+    int index, count;
+    char slash, rest;
+    std::istringstream stream(spec);
+    if (!(stream >> index >> slash >> count) || slash != '/' || stream >> rest || index < 0 || index >= count) {
+        return false;
+    }
+    shard.index = index;
+    shard.count = count;
+    return true;
+}
+
+std::vector<Tile> generateTiles(const RenderSettings& settings) {
+    std::vector<Tile> tiles;
+    for (int y = 0; y < settings.height; y += settings.tileSize) {
+        for (int x = 0; x < settings.width; x += settings.tileSize) {
+            tiles.emplace_back(x, y,
+                               std::min(x + settings.tileSize, settings.width),
+                               std::min(y + settings.tileSize, settings.height));
+        }
+    }
+    return tiles;
+}
+
+bool shardOwnsTile(const RenderSettings& settings, size_t tileIndex) {
+    // parseShard leaves count and index non-negative
+    return settings.shard.mode != ShardMode::Tiles ||
+           tileIndex % static_cast<size_t>(settings.shard.count) == static_cast<size_t>(settings.shard.index);
+}
+
+void shardSampleRange(const RenderSettings& settings, int& begin, int& end) {
+    begin = 0;
+    end = settings.samples;
+    if (settings.shard.mode == ShardMode::Samples) {
+        begin = static_cast<int>(static_cast<long>(settings.samples) * settings.shard.index / settings.shard.count);
+        end = static_cast<int>(static_cast<long>(settings.samples) * (settings.shard.index + 1) / settings.shard.count);
+    }
+}
+
+glm::vec2 samplePixelOffset(const RenderSettings& settings, int sample) {
+    glm::vec2 offset(randomFloat(0.0f, 1.0f), randomFloat(0.0f, 1.0f));
+    
+    // samples past the largest square grid that fits in the sample count are left uniform
+    const int strata = static_cast<int>(std::sqrt(static_cast<float>(settings.samples)));
+    if (settings.sampler == Sampler::Stratified && sample < strata * strata) {
+        offset = (glm::vec2(sample % strata, sample / strata) + offset) / static_cast<float>(strata);
+    }
+    return offset;
+}
+
+glm::vec2 pixelToImage(const RenderSettings& settings, int col, int row, const glm::vec2& offset) {
+    return glm::vec2(((float)col + offset.x) / settings.width,
+                     ((float)row + offset.y) / settings.height);
+}
+
+ThreadSettingsScope::ThreadSettingsScope(bool fastMath, const ShadingCache* shadingCache) :
+    previousFastMath(fastMathEnabled()), previousShadingCache(threadShadingCache()) {
+    setFastMath(fastMath);
+    setShadingCache(shadingCache);
+}
+
+ThreadSettingsScope::~ThreadSettingsScope() {
+    setFastMath(previousFastMath);
+    setShadingCache(previousShadingCache);
+}
+
+void renderTileRecursive(const Scene& scene,
+                         const Camera& camera,
+                         const RenderSettings& settings,
+                         const Tile& tile,
+                         FilmTile& film,
+                         RenderProfile* profile) {
+    int sampleBegin, sampleEnd;
+    shardSampleRange(settings, sampleBegin, sampleEnd);
+    
+    for (int row = tile.y0; row < tile.y1; row++) {
+        for (int col = tile.x0; col < tile.x1; col++) {
+            const auto start = std::chrono::steady_clock::now();
+            const uint64_t tests = primitiveTests();
+            
+            for (int sample = sampleBegin; sample < sampleEnd; sample++) {
+                STATS_COUNT(CameraRays);
+                const glm::vec2 offset = samplePixelOffset(settings, sample);
+                // implicit origin is the camera position
+                Ray ray = camera.generateRay(pixelToImage(settings, col, row, offset));
+                film.addSample(col, row, offset, castRay(scene, ray, settings.bounces));
+            }
+            
+            if (profile) {
+                profile->pixelSeconds[row * settings.width + col] =
+                    std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                profile->pixelTests[row * settings.width + col] = primitiveTests() - tests;
+            }
+        }
+    }
+}
+
+// progress of one render's tiles. pool tasks can outlive the render call (they may only get dequeued after every tile
+// is done), so they share ownership of this, and a task that finds no tiles left touches nothing else
+struct TileQueue {
+    const size_t numTiles;
+    std::atomic<size_t> nextTile;
+    size_t tilesDone = 0;
+    std::mutex mutex; // guards tilesDone and the profile's tile events
+    std::condition_variable allDone;
+    
+    TileQueue(size_t numTiles) : numTiles(numTiles), nextTile(0) {}
+};
+
+Accumulator render(const Scene& scene,
+                   const Camera& camera,
+                   const RenderSettings& settings,
+                   RenderProfile* profile,
+                   ThreadPool* pool,
+                   const ShadingCache* shadingCache) {
+    Accumulator accumulator;
+    accumulator.reset(settings.width, settings.height);
+    
+    int sampleBegin, sampleEnd;
+    shardSampleRange(settings, sampleBegin, sampleEnd);
+    
+    const std::vector<Tile> tiles = generateTiles(settings);
+    Film film(accumulator, settings.filter, tiles);
+    std::unique_ptr<ShadingCache> builtShadingCache;
+    if (!settings.shadingCache) {
+        shadingCache = nullptr;
+    } else if (!shadingCache) {
+        builtShadingCache.reset(new ShadingCache(scene, settings.shadingCacheCellSize));
+        builtShadingCache->populate(scene, camera, settings);
+        shadingCache = builtShadingCache.get();
+    }
+    std::shared_ptr<TileQueue> queue = std::make_shared<TileQueue>(tiles.size());
+    
+    const auto renderStart = std::chrono::steady_clock::now();
+    auto secondsSinceStart = [renderStart]() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - renderStart).count();
+    };
+    if (profile) {
+        profile->reset(settings.width * settings.height);
+    }
+    
+    // sample shards of the same frame must not share random streams, while tile shards (which never share a tile)
+    // keep the unsharded streams so that their union is exactly the unsharded render
+    uint64_t stream = settings.seed;
+    if (settings.shard.mode == ShardMode::Samples) {
+        stream = settings.seed * settings.shard.count + settings.shard.index;
+    }
+    
+    // tiles never overlap, so threads write disjoint parts of the film (see film.hpp) and profile and need no further
+    // synchronization
+    auto worker = [&, queue, secondsSinceStart](int thread) {
+        for (size_t tileIndex = queue->nextTile++; tileIndex < queue->numTiles; tileIndex = queue->nextTile++) {
+            if (shardOwnsTile(settings, tileIndex) && std::chrono::steady_clock::now() < settings.deadline) {
+                STATS_TIME(RenderTile);
+                const Tile& tile = tiles[tileIndex];
+                const double start = secondsSinceStart();
+                seedRandom(stream * tiles.size() + tileIndex);
+                ThreadSettingsScope threadSettings(settings.fastMath, shadingCache);
+                FilmTile filmTile = film.tile(tileIndex);
+                if (settings.integrator == Integrator::Wavefront) {
+                    renderTileWavefront(scene, camera, settings, tile, filmTile, profile);
+                } else {
+                    renderTileRecursive(scene, camera, settings, tile, filmTile, profile);
+                }
+                for (int row = tile.y0; row < tile.y1; row++) {
+                    std::fill(accumulator.samples.begin() + row * settings.width + tile.x0,
+                              accumulator.samples.begin() + row * settings.width + tile.x1,
+                              sampleEnd - sampleBegin);
+                }
+                if (profile) {
+                    std::lock_guard<std::mutex> lock(queue->mutex);
+                    profile->tileEvents.push_back({ thread, tileIndex, tile.x0, tile.y0, tile.x1, tile.y1,
+                                                    start, secondsSinceStart() });
+                }
+            }
+            
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            if (++queue->tilesDone == queue->numTiles) {
+                queue->allDone.notify_all();
+            }
+        }
+    };
+    
+    // the calling thread works through tiles as well, so a render still finishes while the pool is busy elsewhere
+    std::vector<std::thread> threads;
+    if (pool) {
+        for (int i = 1; i <= pool->size(); i++) {
+            pool->submit([worker, i]() { worker(i); });
+        }
+    } else {
+        int numThreads = settings.threads > 0 ? settings.threads : std::max(1u, std::thread::hardware_concurrency());
+        for (int i = 1; i < numThreads; i++) {
+            threads.emplace_back(worker, i);
+        }
+    }
+    worker(0);
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    queue->allDone.wait(lock, [&queue]() { return queue->tilesDone == queue->numTiles; });
+    film.resolve();
+    return accumulator;
+}
+
+// the preview pass renders at 1 / kPreviewDownscale of the resolution in each dimension
+const int kPreviewDownscale = 4;
+
+Accumulator renderProgressive(const Scene& scene,
+                              const Camera& camera,
+                              const RenderSettings& settings,
+                              double budgetSeconds,
+                              const std::function<void(const Accumulator& image, int pass)>& onPass,
+                              ThreadPool* pool) {
+    const auto start = std::chrono::steady_clock::now();
+    RenderSettings passSettings = settings;
+    passSettings.deadline = start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+        std::chrono::duration<double>(budgetSeconds));
+    
+    // the cache only depends on the scene and camera, so every pass (the preview included) shares one
+    std::unique_ptr<ShadingCache> shadingCache;
+    if (settings.shadingCache) {
+        shadingCache.reset(new ShadingCache(scene, settings.shadingCacheCellSize));
+        shadingCache->populate(scene, camera, settings);
+    }
+    
+    // the camera works in normalized image coordinates, so it renders the preview as is. the tiles shrink along with
+    // the image so that there are still as many to spread over the threads
+    RenderSettings previewSettings = passSettings;
+    previewSettings.width = std::max(1, settings.width / kPreviewDownscale);
+    previewSettings.height = std::max(1, settings.height / kPreviewDownscale);
+    previewSettings.tileSize = std::max(1, settings.tileSize / kPreviewDownscale);
+    previewSettings.samples = 1;
+    const auto previewStart = std::chrono::steady_clock::now();
+    const Accumulator preview = render(scene, camera, previewSettings, nullptr, pool, shadingCache.get());
+    const double previewSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                                previewStart).count();
+    
+    Accumulator accumulated;
+    accumulated.reset(settings.width, settings.height);
+    
+    int pass = 0;
+    auto publish = [&]() {
+        Accumulator image = accumulated;
+        for (int row = 0; row < settings.height; row++) {
+            for (int col = 0; col < settings.width; col++) {
+                const int pixel = row * settings.width + col;
+                const int previewPixel = (row * previewSettings.height / settings.height) * previewSettings.width +
+                                         col * previewSettings.width / settings.width;
+                if (image.samples[pixel] == 0) {
+                    image.sum[pixel] = preview.sum[previewPixel];
+                    image.samples[pixel] = preview.samples[previewPixel];
+                    image.weight[pixel] = preview.weight[previewPixel];
+                }
+            }
+        }
+        onPass(image, pass++);
+    };
+    publish();
+    
+    // full resolution passes, sized from how long the previous pass took per sample (the preview, scaled up, at first)
+    double secondsPerSample = previewSeconds * kPreviewDownscale * kPreviewDownscale;
+    int samplesDone = 0;
+    while (samplesDone < settings.samples && std::chrono::steady_clock::now() < passSettings.deadline) {
+        const double secondsLeft = std::chrono::duration<double>(passSettings.deadline -
+                                                                 std::chrono::steady_clock::now()).count();
+        const int samplesThatFit = static_cast<int>(secondsLeft / std::max(secondsPerSample, 1e-9));
+        passSettings.samples = std::max(1, std::min({ std::max(samplesDone, 1), samplesThatFit,
+                                                      settings.samples - samplesDone }));
+        passSettings.seed = settings.seed + pass; // independent samples in every pass
+        
+        const auto passStart = std::chrono::steady_clock::now();
+        accumulated.merge(render(scene, camera, passSettings, nullptr, pool, shadingCache.get()));
+        secondsPerSample = std::chrono::duration<double>(std::chrono::steady_clock::now() - passStart).count() /
+                           passSettings.samples;
+        samplesDone += passSettings.samples;
+        publish();
+    }
+    
+    return accumulated;
+}
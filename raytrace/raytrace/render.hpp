@@ -0,0 +1,161 @@
+/**
+ * @file render.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef render_hpp
+#define render_hpp
+
+#include "camera.hpp"
+#include "film.hpp"
+#include "image.hpp"
+#include "profile.hpp"
+#include "scene.hpp"
+#include "threadpool.hpp"
+#include "util.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ShadingCache;
+
+// how a tile's samples are turned into radiance: one recursive castRay per sample, or batched stages over the tile
+enum class Integrator {
+    Recursive,
+    Wavefront,
+};
+
+bool parseIntegrator(const std::string& name, Integrator& integrator);
+
+// where in a pixel each sample lands: uniformly at random, or jittered within a sqrt(spp) x sqrt(spp) grid of strata
+enum class Sampler {
+    Random,
+    Stratified,
+};
+
+bool parseSampler(const std::string& name, Sampler& sampler);
+
+/**
+ * The part of a frame this process renders, so that one frame can be split across processes (or machines) and the
+ * partial results merged afterwards (see raytrace_merge). shard index of count takes either every count-th tile, or
+ * its slice of every pixel's samples. either way the shards' work is disjoint and, between them, covers the frame
+ *
+ */
+enum class ShardMode {
+    Tiles,
+    Samples,
+};
+
+bool parseShardMode(const std::string& name, ShardMode& mode);
+
+struct Shard {
+    int index = 0;
+    int count = 1;
+    ShardMode mode = ShardMode::Tiles;
+};
+
+// parses "i/N" with 0 <= i < N
+bool parseShard(const std::string& spec, Shard& shard);
+
+struct RenderSettings {
+    int width = 0;
+    int height = 0;
+    int samples = 1;
+    int bounces = 1;
+    int tileSize = 32;
+    int threads = 0; // 0 uses every hardware thread
+    Integrator integrator = Integrator::Recursive;
+    Sampler sampler = Sampler::Random;
+    bool fastMath = false; // approximate, branch free sampling math (see sampling.hpp)
+    Filter filter; // how samples are weighted into the pixels around them (see film.hpp)
+    bool shadingCache = false; // adapt Lambertian sampling mixtures per cell of a hash grid (see shadingcache.hpp)
+    float shadingCacheCellSize = 0; // edge of the cache's cells, where <= 0 picks one from the scene
+    uint64_t seed = 0; // renders with different seeds draw independent samples, so they can be averaged together
+    Shard shard;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max(); // see render()
+};
+
+std::vector<Tile> generateTiles(const RenderSettings& settings);
+
+bool shardOwnsTile(const RenderSettings& settings, size_t tileIndex);
+
+// half-open range [begin, end) of sample indices this shard takes in every pixel it renders
+void shardSampleRange(const RenderSettings& settings, int& begin, int& end);
+
+// jittered position of the sample-th sample within its pixel, in [0, 1)^2
+glm::vec2 samplePixelOffset(const RenderSettings& settings, int sample);
+
+// normalized image coordinate of the point at offset within pixel (col, row), as the camera takes it
+glm::vec2 pixelToImage(const RenderSettings& settings, int col, int row, const glm::vec2& offset);
+
+/**
+ * sets the calling thread's fast math mode (see sampling.hpp) and shading cache (see shadingcache.hpp) for as long as
+ * it is in scope, then puts back what they were before, so that whatever a thread goes on to run (pool threads move
+ * between renders with different settings) never inherits them
+ *
+ */
+struct ThreadSettingsScope {
+    ThreadSettingsScope(bool fastMath, const ShadingCache* shadingCache);
+    ~ThreadSettingsScope();
+    
+    ThreadSettingsScope(const ThreadSettingsScope&) = delete;
+    ThreadSettingsScope& operator=(const ThreadSettingsScope&) = delete;
+    
+    bool previousFastMath;
+    const ShadingCache* previousShadingCache;
+};
+
+void renderTileRecursive(const Scene& scene,
+                         const Camera& camera,
+                         const RenderSettings& settings,
+                         const Tile& tile,
+                         FilmTile& film,
+                         RenderProfile* profile);
+
+/**
+ * renders the full image, returning the filtered *sum* of the samples around each pixel along with their total weight
+ * and how many samples the pixel itself took. tiles are pulled off a shared counter by the render threads, and each
+ * tile reseeds its thread's generator from its index (and settings.seed) so a render is reproducible regardless of
+ * which thread ends up with which tile. in particular, tile shards reproduce exactly the pixels of an unsharded render
+ * (up to the order sums are added in where filters reach across tiles), while sample shards also fold the shard into
+ * the seed. tiles left to other shards, or not yet started by settings.deadline, are skipped and count 0 samples.
+ *
+ * if a profile is passed in, it is reset and filled in with where the render spent its time. the render threads are
+ * started just for this call (settings.threads of them), unless a pool is passed in to share with other renders.
+ * with settings.shadingCache, the render builds and populates its own cache unless one already populated for this
+ * scene and camera is passed in
+ *
+ */
+Accumulator render(const Scene& scene,
+                   const Camera& camera,
+                   const RenderSettings& settings,
+                   RenderProfile* profile = nullptr,
+                   ThreadPool* pool = nullptr,
+                   const ShadingCache* shadingCache = nullptr);
+
+/**
+ * renders to a wall clock budget rather than a fixed number of samples: first a quick pass at a quarter of the
+ * resolution, then full resolution passes that each (roughly) double the samples so far, as far as the remaining time
+ * is expected to allow. it stops at settings.samples per pixel or at the deadline, whichever comes first, cutting the
+ * last pass short at tile granularity if need be.
+ *
+ * with settings.shadingCache, the cache is built once up front and shared by every pass.
+ *
+ * after every pass onPass gets the best image so far, where pixels the full resolution passes have not reached yet
+ * are filled in from the preview. the return value only holds the full resolution samples
+ *
+ */
+Accumulator renderProgressive(const Scene& scene,
+                              const Camera& camera,
+                              const RenderSettings& settings,
+                              double budgetSeconds,
+                              const std::function<void(const Accumulator& image, int pass)>& onPass,
+                              ThreadPool* pool = nullptr);
+
+#endif /* render_hpp */
@@ -0,0 +1,137 @@
+/**
+ * @file sampling.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef sampling_hpp
+#define sampling_hpp
+
+#include "util.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include <glm/glm.hpp>
+
+/* ***********************************************************************
+ * Fast math sampling
+ * -----------------------------------------------------------------------
+ * The samplers in material.cpp and camera.hpp map uniform random numbers to
+ * directions through cos/sin of an angle, pow, and (for the lens) rejection.
+ * With fast math on, they switch to the mappings below instead, which are
+ * straight-line code: no libm calls, no loops, and selects rather than
+ * branches, so the compiler can vectorize them wherever they are called over
+ * a batch.
+ *
+ *   fastSinCos:      polynomial sin/cos of an angle given in turns, for the
+ *                    hemisphere and sphere samplers
+ *   concentricSampleDisc:
+ *                    Shirley and Chiu's area preserving square to disc map,
+ *                    for the lens and GGX visible normals, in place of
+ *                    rejection or polar coordinates (sqrt, cos, sin)
+ *   branchlessBasis: Duff et al.'s orthonormal basis around a unit vector
+ *                    (JCGT 2017), in place of a cross product against
+ *                    whichever axis is far enough from it
+ *
+ * Each of these produces the same distribution of samples as the exact code
+ * (up to float rounding), but not the same samples: the basis is rotated
+ * differently about the normal, and the disc map pairs up random numbers
+ * and points differently. So fast math renders converge to the same image
+ * without matching the exact renders bit for bit. raytrace_bench checks the
+ * difference stays within the noise (see BM_FastMathImageDifference).
+ *
+ * The cosine weighted hemisphere keeps its polar mapping (with fastSinCos),
+ * since the disc map's division costs more there than the sin/cos it saves.
+ *
+ * Whether fast math is on is per thread, like the random state. render()
+ * sets it from RenderSettings::fastMath for the length of each tile only
+ * (see ThreadSettingsScope), so threads go back to the exact code after.
+ * *********************************************************************** */
+
+inline bool& threadFastMath() {
+    thread_local bool fastMath = false;
+    return fastMath;
+}
+
+inline void setFastMath(bool enabled) {
+    threadFastMath() = enabled;
+}
+
+inline bool fastMathEnabled() {
+    return threadFastMath();
+}
+
+// sin and cos of x in [-pi/4, pi/4], where their Taylor series up to x^9 and x^10 are well within float precision
+inline void sinCosPolynomial(float x, float& sine, float& cosine) {
+    const float x2 = x * x;
+    sine = x * (1 - x2 * (1.0f / 6) * (1 - x2 * (1.0f / 20) * (1 - x2 * (1.0f / 42) * (1 - x2 * (1.0f / 72)))));
+    cosine = 1 - x2 * (1.0f / 2) * (1 - x2 * (1.0f / 12) * (1 - x2 * (1.0f / 30) * (1 - x2 * (1.0f / 56) *
+             (1 - x2 * (1.0f / 90)))));
+}
+
+/**
+ * sin and cos of 2 pi turns, for turns >= 0. the angle is reduced to within an eighth of a turn of the nearest
+ * quarter turn q, and the polynomials' results are then rotated by q quarter turns. the rotation is arithmetic on
+ * the bits of q rather than a ternary, which compilers tend to turn into a branch that random angles mispredict
+ *
+ */
+inline void fastSinCos(float turns, float& sine, float& cosine) {
+    const int quarter = static_cast<int>(turns * 4 + 0.5f); // truncation rounds, since turns * 4 + 0.5 > 0
+    float s, c;
+    sinCosPolynomial(static_cast<float>(2 * M_PI) * (turns - 0.25f * quarter), s, c);
+    
+    const float odd = static_cast<float>(quarter & 1); // sin and cos trade places every quarter turn...
+    const float sign = 1.0f - static_cast<float>(quarter & 2); // ...and both flip sign every half turn
+    sine = sign * (s + odd * (c - s));
+    cosine = sign * (c - odd * (c + s));
+}
+
+/**
+ * maps [0, 1)^2 onto the unit disc, preserving area (so uniform in, uniform out). the square is split into four
+ * triangles by its diagonals, each of which maps to a quarter of the disc: concentric squares go to concentric
+ * circles, which keeps stratified inputs stratified. the angle within each quarter is at most an eighth of a turn
+ * either side of its axis, so it needs no reduction, and the quarter is blended in arithmetically (as in fastSinCos)
+ *
+ */
+inline glm::vec2 concentricSampleDisc(float u1, float u2) {
+    const float a = 2 * u1 - 1;
+    const float b = 2 * u2 - 1;
+    const float horizontal = static_cast<float>(a * a > b * b);
+    const float radius = b + horizontal * (a - b);
+    if (radius == 0) {
+        return glm::vec2(0, 0);
+    }
+    // the left/right quarters are at angle pi/4 * b/a from the x axis, the top/bottom ones at pi/4 * a/b from the y
+    // axis, i.e. with sin and cos swapped
+    float s, c;
+    sinCosPolynomial(static_cast<float>(M_PI / 4) * (a + horizontal * (b - a)) / radius, s, c);
+    return glm::vec2(radius * (s + horizontal * (c - s)), radius * (c + horizontal * (s - c)));
+}
+
+/**
+ * orthonormal basis with n (which must be unit length) as the z axis, from "Building an Orthonormal Basis,
+ * Revisited" (Duff et al., JCGT 2017). copysign takes the place of the branch on which axis n is closest to
+ *
+ */
+inline glm::mat3 branchlessBasis(const glm::vec3& n) {
+    const float sign = std::copysign(1.0f, n.z);
+    const float a = -1.0f / (sign + n.z);
+    const float b = n.x * n.y * a;
+    
+    glm::mat3 basis;
+    basis[0] = glm::vec3(1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x);
+    basis[1] = glm::vec3(b, sign + n.y * n.y * a, -n.y);
+    basis[2] = n;
+    return basis;
+}
+
+// x^5 by multiplication, for Schlick's approximation
+inline float pow5(float x) {
+    const float x2 = x * x;
+    return x2 * x2 * x;
+}
+
+#endif /* sampling_hpp */
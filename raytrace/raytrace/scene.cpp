@@ -9,6 +9,7 @@
 #include "scene.hpp"
 
 #include "material.hpp"
+#include "stats.hpp"
 
 #include <iostream>
 
@@ -17,10 +18,10 @@
 Scene generateBallScene() {
     Scene scene;
     
-    scene.addSphere(glm::vec3(0.0, 0.0, -3.5), 0.5, std::make_shared<Lambertian>(PEACH));
-    scene.addSphere(glm::vec3(2.2, 0.5, -2.5), 1.0, std::make_shared<Metal>(AQUA, 0.1));
-    scene.addSphere(glm::vec3(-1.6, 0.3, -2.0), 0.8, std::make_shared<Dielectric>(1.5));
-    scene.addSphere(glm::vec3(0.0, -1000.5, -2.0), 1000.0, std::make_shared<Lambertian>(BEIGE));
+    scene.addSphere(glm::vec3(0.0, 0.0, -3.5), 0.5, scene.makeMaterial<Lambertian>(PEACH));
+    scene.addSphere(glm::vec3(2.2, 0.5, -2.5), 1.0, scene.makeMaterial<Metal>(AQUA, 0.1));
+    scene.addSphere(glm::vec3(-1.6, 0.3, -2.0), 0.8, scene.makeMaterial<Dielectric>(1.5));
+    scene.addSphere(glm::vec3(0.0, -1000.5, -2.0), 1000.0, scene.makeMaterial<Lambertian>(BEIGE));
 
     const int kBallGridSize = 5;
     const float kBallRadius = 0.2;
@@ -35,11 +36,11 @@ Scene generateBallScene() {
             glm::vec3 randColor = glm::linearRand(glm::vec3(0, 0, 0), glm::vec3(1, 1, 1));
             float random = glm::linearRand(0.0f, 1.0f);
             if (random < 0.8) {
-                scene.addSphere(center, ballRadius, std::make_shared<Lambertian>(randColor));
+                scene.addSphere(center, ballRadius, scene.makeMaterial<Lambertian>(randColor));
             } else if (random < 0.95) {
-                scene.addSphere(center, ballRadius, std::make_shared<Metal>(randColor, glm::linearRand(0.0f, 1.0f)));
+                scene.addSphere(center, ballRadius, scene.makeMaterial<Metal>(randColor, glm::linearRand(0.0f, 1.0f)));
             } else {
-                scene.addSphere(center, ballRadius, std::make_shared<Dielectric>(1.5));
+                scene.addSphere(center, ballRadius, scene.makeMaterial<Dielectric>(1.5));
             }
         }
     }
@@ -58,38 +59,68 @@ const int sizeZ = 250;
 Scene generateCornellBoxScene() {
     Scene scene;
 
-    scene.addXYPlane(-sizeX, -sizeY, sizeX, sizeY, centerZ - sizeZ, true, 0.0, std::make_shared<Lambertian>(WHITE)); // back
-    scene.addYZPlane(-sizeY, centerZ - sizeZ, sizeY, centerZ + sizeZ, -sizeX, true, 0.0, std::make_shared<Lambertian>(GREEN)); // left
-    scene.addYZPlane(-sizeY, centerZ - sizeZ, sizeY, centerZ + sizeZ, sizeX, false, 0.0, std::make_shared<Lambertian>(RED)); // right
-    scene.addXZPlane(-sizeX, centerZ - sizeZ, sizeX, centerZ + sizeZ, -sizeY, true, 0.0, std::make_shared<Lambertian>(WHITE)); // bottom
-    scene.addXZPlane(-sizeX, centerZ - sizeZ, sizeX, centerZ + sizeZ, sizeY, false, 0.0, std::make_shared<Lambertian>(WHITE)); // top
+    scene.addXYPlane(-sizeX, -sizeY, sizeX, sizeY, centerZ - sizeZ, true, 0.0, scene.makeMaterial<Lambertian>(WHITE)); // back
+    scene.addYZPlane(-sizeY, centerZ - sizeZ, sizeY, centerZ + sizeZ, -sizeX, true, 0.0, scene.makeMaterial<Lambertian>(GREEN)); // left
+    scene.addYZPlane(-sizeY, centerZ - sizeZ, sizeY, centerZ + sizeZ, sizeX, false, 0.0, scene.makeMaterial<Lambertian>(RED)); // right
+    scene.addXZPlane(-sizeX, centerZ - sizeZ, sizeX, centerZ + sizeZ, -sizeY, true, 0.0, scene.makeMaterial<Lambertian>(WHITE)); // bottom
+    scene.addXZPlane(-sizeX, centerZ - sizeZ, sizeX, centerZ + sizeZ, sizeY, false, 0.0, scene.makeMaterial<Lambertian>(WHITE)); // top
     
     scene.addXZPlane(-sizeX / 2.0, centerZ - sizeZ / 2.0,
-                     sizeX / 2.0, centerZ + sizeZ / 2.0, sizeY - .005, true, 0.0, std::make_shared<Light>(LIGHT_GRAY)); // on ceilling
+                     sizeX / 2.0, centerZ + sizeZ / 2.0, sizeY - .005, true, 0.0, scene.makeMaterial<Light>(LIGHT_GRAY)); // on ceilling
     
     scene.addBox(glm::vec3(550.0 + -sizeX / 3.0, -sizeY + 0.01, 10.0 + centerZ - sizeZ / 3.0),
                  glm::vec3(550.0 + sizeX / 3.0, 1.0 * sizeY / 5.0, 10.0 + centerZ + sizeZ / 3.0),
                  0.45,
-                 std::make_shared<Lambertian>(WHITE));
+                 scene.makeMaterial<Lambertian>(WHITE));
 //    scene.addBox(glm::vec3(-650.0 + -sizeX / 4.0, -sizeY + 0.01, 225.0 + centerZ - sizeZ / 4.0),
 //                 glm::vec3(-650.0 + sizeX / 4.0, -2.0 * sizeY / 5.0, 225.0 + centerZ + sizeZ / 4.0),
 //                 -0.55,
-//                 std::make_shared<Lambertian>(WHITE));
+//                 scene.makeMaterial<Lambertian>(WHITE));
     scene.addSphere(
                     glm::vec3(175.0, -3.0 * sizeY / 5.0, 200.0 + centerZ - sizeZ / 4.0),
-                    200.0, std::make_shared<Dielectric>(1.5));
+                    200.0, scene.makeMaterial<Dielectric>(1.5));
     
     scene.backgroundColor = BLACK;
     
     return scene;
 }
 
+bool generateScene(const std::string& name, Scene& scene) {
+    if (name == "cornell") {
+        scene = generateCornellBoxScene();
+    } else if (name == "balls") {
+        scene = generateBallScene();
+    } else {
+        return false;
+    }
+    scene.bvh.build(scene.geometry);
+    return true;
+}
+
+void setSamplingMixture(Scene& scene, const SamplingMixture& mixture) {
+    for (Geometry* geometry : scene.geometry) {
+        if (Lambertian* lambertian = std::get_if<Lambertian>(geometry->material)) {
+            lambertian->mixture = mixture;
+        }
+    }
+}
+
 void populateClosestIntersection(const Scene& scene,
                                  const Ray& ray,
-                                 std::shared_ptr<Geometry>& closestObject,
+                                 Geometry*& closestObject,
                                  float& closestIntersection,
                                  glm::vec3& closestIntersectionPoint) {
-    for (const std::shared_ptr<Geometry>& geometry : scene.geometry) {
+    STATS_COUNT(RaysCast);
+    STATS_TIME(ClosestIntersection);
+    if (!scene.bvh.empty()) {
+        int closest = scene.bvh.intersect(scene.geometry, ray, closestIntersection, closestIntersectionPoint);
+        if (closest >= 0) {
+            closestObject = scene.geometry[closest];
+        }
+        return;
+    }
+    
+    for (Geometry* geometry : scene.geometry) {
         glm::vec3 intersectionPoint;
         float intersection = geometry->intersect(ray, intersectionPoint);
         if (intersection > 0 && intersection < closestIntersection) {
@@ -109,8 +140,9 @@ Color castRay(const Scene& scene, const Ray& ray, int bounce) {
     if (bounce < 0) {
         return BLACK;
     }
+    STATS_RAY_BOUNCES_LEFT(bounce);
     
-    std::shared_ptr<Geometry> closestObject;
+    Geometry* closestObject = nullptr;
     float closestIntersection = std::numeric_limits<float>::max();
     glm::vec3 closestIntersectionPoint;
     populateClosestIntersection(scene, ray, closestObject, closestIntersection, closestIntersectionPoint);
@@ -118,34 +150,36 @@ Color castRay(const Scene& scene, const Ray& ray, int bounce) {
     if (closestIntersection < std::numeric_limits<float>::max()) {
         glm::vec3 normal = closestObject->normal(closestIntersectionPoint);
         bool inside = glm::dot(ray.direction, normal) > 0;
-
-        Ray scatteredRay;
-        Color scatteredColor;
-        Color emissionColor = closestObject->material->emit(closestIntersectionPoint, normal);
-        double pdf;
         
-        bool didScatter = closestObject->material->scatter(ray,
-                                                           closestIntersectionPoint,
-                                                           normal,
-                                                           inside,
-                                                           scatteredRay,
-                                                           scatteredColor,
-                                                           pdf);
-        if (!didScatter) {
-            return emissionColor;
+        // diffuse light after the first bounce may already have converged in earlier frames of an animation. with no
+        // bounces left there is nothing to cache, since the estimate is just the (zero) emission
+        RadianceCache* cache = scene.radianceCache.get();
+        const bool cached = cache && bounce > 0 && bounce < cache->primaryBounces &&
+                            std::holds_alternative<Lambertian>(*closestObject->material);
+        Color radiance;
+        if (cached && cache->lookup(closestObject, closestIntersectionPoint, inside, bounce, radiance)) {
+            return radiance;
         }
-        
-        // recall: E_{X ~ P}[A * color * (s / P)] is an MIS estimate w/ sampling distribution P and scatter S
-        // this equation maps exactly to this line of code, with scatterPDF being S and pdf being P
-        
-        // if P == 0, that means the scattering distribution has not been defined for that material, so we *don't*
-        // do MIS in that case and just use standard sampling
-        if (pdf == 0.0) {
-            return emissionColor + scatteredColor * castRay(scene, scatteredRay, bounce - 1);
+
+        Color emissionColor = emit(*closestObject->material, closestIntersectionPoint, normal);
+        ScatterRecord scattered = scatter(*closestObject->material, ray, closestIntersectionPoint, normal, inside);
+        if (!scattered.didScatter) {
+            radiance = emissionColor;
+        } else if (scattered.pdf == 0.0) {
+            // if P == 0, that means the scattering distribution has not been defined for that material, so we *don't*
+            // do MIS in that case and just use standard sampling
+            radiance = emissionColor + scattered.color * castRay(scene, scattered.out, bounce - 1);
+        } else {
+            // recall: E_{X ~ P}[A * color * (s / P)] is an MIS estimate w/ sampling distribution P and scatter S
+            // this equation maps exactly to this line of code, with scatterPDF being S and pdf being P
+            radiance = emissionColor + scattered.color * castRay(scene, scattered.out, bounce - 1) *
+                (scatterPDF(*closestObject->material, ray, normal, scattered.out.direction) / scattered.pdf);
         }
         
-        return emissionColor + scatteredColor * castRay(scene, scatteredRay, bounce - 1) *
-            static_cast<float>(closestObject->material->scatterPDF(normal, scatteredRay.direction) / pdf);
+        if (cached) {
+            cache->record(closestObject, closestIntersectionPoint, inside, bounce, radiance);
+        }
+        return radiance;
     }
     
     return scene.backgroundColor;
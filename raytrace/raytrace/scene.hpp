@@ -9,18 +9,40 @@
 #ifndef scene_hpp
 #define scene_hpp
 
+#include "arena.hpp"
+#include "bvh.hpp"
 #include "geometry.hpp"
 #include "material.hpp"
+#include "mesh.hpp"
+#include "radiancecache.hpp"
 #include "util.hpp"
 
+#include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
+/**
+ * Everything a scene is built from (its geometry, and the materials they point to) lives in the scene's arena, which
+ * releases all of it in one go along with the scene. pointers into the scene are therefore stable for as long as the
+ * scene itself is around (moving a scene keeps its arena), and hot paths pass plain pointers around rather than
+ * touching reference counts
+ *
+ */
 struct Scene {
-    std::vector<std::shared_ptr<Geometry>> geometry;
+    std::unique_ptr<Arena> arena = std::make_unique<Arena>();
+    std::vector<Geometry*> geometry;
     Color backgroundColor;
+    BVH bvh; // over geometry, once built. closest hit queries fall back to testing everything while it is empty
+    std::shared_ptr<RadianceCache> radianceCache; // only set while rendering an animation that reuses lighting
+    
+    template <typename MaterialT, typename... Args>
+    Material* makeMaterial(Args&&... args) {
+        return arena->make<Material>(MaterialT(std::forward<Args>(args)...));
+    }
     
-    void addSphere(const glm::vec3& center, float radius, const std::shared_ptr<Material> material) {
-        geometry.push_back(std::make_shared<Sphere>(center, radius, material));
+    void addSphere(const glm::vec3& center, float radius, Material* material) {
+        geometry.push_back(arena->make<Sphere>(center, radius, material));
     }
     
     void addXYPlane(const float x1,
@@ -30,8 +52,8 @@ struct Scene {
                     const float z,
                     const bool facingAxis,
                     const float yAxisRotation,
-                    std::shared_ptr<Material> material) {
-        geometry.push_back(std::make_shared<XYPlane>(x1, y1, x2, y2, z, facingAxis, yAxisRotation, material));
+                    Material* material) {
+        geometry.push_back(arena->make<XYPlane>(x1, y1, x2, y2, z, facingAxis, yAxisRotation, material));
     }
     
     void addXZPlane(const float x1,
@@ -41,8 +63,8 @@ struct Scene {
                     const float y,
                     const bool facingAxis,
                     const float yAxisRotation,
-                    std::shared_ptr<Material> material) {
-        geometry.push_back(std::make_shared<XZPlane>(x1, z1, x2, z2, y, facingAxis, yAxisRotation, material));
+                    Material* material) {
+        geometry.push_back(arena->make<XZPlane>(x1, z1, x2, z2, y, facingAxis, yAxisRotation, material));
     }
     
     void addYZPlane(const float y1,
@@ -52,25 +74,41 @@ struct Scene {
                     const float x,
                     const bool facingAxis,
                     const float yAxisRotation,
-                    std::shared_ptr<Material> material)  {
-        geometry.push_back(std::make_shared<YZPlane>(y1, z1, y2, z2, x, facingAxis, yAxisRotation, material));
+                    Material* material)  {
+        geometry.push_back(arena->make<YZPlane>(y1, z1, y2, z2, x, facingAxis, yAxisRotation, material));
     }
     
     void addBox(const glm::vec3& minCorner,
                 const glm::vec3& maxCorner,
                 const float yAxisRotation,
-                std::shared_ptr<Material> material)  {
-        geometry.push_back(std::make_shared<Box>(minCorner, maxCorner, yAxisRotation, material));
+                Material* material)  {
+        geometry.push_back(arena->make<Box>(minCorner, maxCorner, yAxisRotation, material));
+    }
+    
+    // maps a mesh packed by raytrace_meshpack, returning false (with the reason in error) if that fails
+    bool addMesh(const std::string& filename, Material* material, std::string& error) {
+        Mesh* mesh = loadMesh(*arena, filename, material, error);
+        if (!mesh) {
+            return false;
+        }
+        geometry.push_back(mesh);
+        return true;
     }
 };
 
 Scene generateBallScene();
 Scene generateCornellBoxScene();
 
+// looks a scene up by name ("cornell" or "balls") and builds its BVH, returning false if there is no such scene
+bool generateScene(const std::string& name, Scene& scene);
+
+// switches every Lambertian surface in the scene over to the given sampling mixture
+void setSamplingMixture(Scene& scene, const SamplingMixture& mixture);
+
 Color castRay(const Scene& scene, const Ray& ray, int bounce);
 void populateClosestIntersection(const Scene& scene,
                                 const Ray& ray,
-                                std::shared_ptr<Geometry>& closestObject,
+                                Geometry*& closestObject,
                                 float& closestIntersection,
                                 glm::vec3& closestIntersectionPoint);
 
@@ -0,0 +1,255 @@
+/**
+ * @file server.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "server.hpp"
+
+#include "camera.hpp"
+#include "image.hpp"
+#include "render.hpp"
+
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <sstream>
+#include <thread>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+std::shared_ptr<const Scene> SceneCache::get(const std::string& name) {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto cached = scenes.find(name);
+    if (cached != scenes.end()) {
+        return cached->second;
+    }
+    
+    std::shared_ptr<Scene> scene = std::make_shared<Scene>();
+    if (!generateScene(name, *scene)) {
+        return nullptr;
+    }
+    scenes[name] = scene;
+    return scene;
+}
+
+struct Job {
+    std::string id = "-";
+    std::string sceneName = "cornell";
+    RenderSettings settings;
+    glm::vec3 lookFrom = glm::vec3(0, 0, 0);
+    glm::vec3 lookAt = glm::vec3(0, 0, -1);
+    std::string output;
+    std::string partial;
+    FilterType filterType = FilterType::Box;
+    float filterRadius = 0;
+};
+
+bool parseJob(const std::string& line, Job& job, std::string& error) {
+    std::istringstream tokens(line);
+    std::string token;
+    while (tokens >> token) {
+        const size_t equals = token.find('=');
+        if (equals == std::string::npos) {
+            error = "expected key=value: " + token;
+            return false;
+        }
+        const std::string key = token.substr(0, equals);
+        const std::string value = token.substr(equals + 1);
+        
+        bool valid = true;
+        try {
+            if (key == "id") {
+                job.id = value;
+            } else if (key == "scene") {
+                job.sceneName = value;
+            } else if (key == "width") {
+                job.settings.width = std::stoi(value);
+            } else if (key == "height") {
+                job.settings.height = std::stoi(value);
+            } else if (key == "samples") {
+                job.settings.samples = std::stoi(value);
+            } else if (key == "bounces") {
+                job.settings.bounces = std::stoi(value);
+            } else if (key == "tile_size") {
+                job.settings.tileSize = std::stoi(value);
+            } else if (key == "seed") {
+                job.settings.seed = std::stoull(value);
+            } else if (key == "integrator") {
+                valid = parseIntegrator(value, job.settings.integrator);
+            } else if (key == "sampler") {
+                valid = parseSampler(value, job.settings.sampler);
+            } else if (key == "fast_math") {
+                job.settings.fastMath = std::stoi(value) != 0;
+            } else if (key == "shading_cache") {
+                job.settings.shadingCache = std::stoi(value) != 0;
+            } else if (key == "filter") {
+                valid = parseFilterType(value, job.filterType);
+            } else if (key == "filter_radius") {
+                job.filterRadius = std::stof(value);
+                valid = job.filterRadius <= kMaxFilterRadius;
+            } else if (key == "look_from") {
+                valid = parseVec3(value, job.lookFrom);
+            } else if (key == "look_at") {
+                valid = parseVec3(value, job.lookAt);
+            } else if (key == "output") {
+                job.output = value;
+            } else if (key == "partial") {
+                job.partial = value;
+            } else {
+                error = "unknown key: " + key;
+                return false;
+            }
+        } catch (const std::exception&) {
+            valid = false;
+        }
+        if (!valid) {
+            error = "bad value for " + key + ": " + value;
+            return false;
+        }
+    }
+    
+    if (job.settings.width <= 0 || job.settings.height <= 0 || job.settings.samples <= 0 || job.settings.tileSize <= 0) {
+        error = "width, height, samples and tile_size must be positive";
+        return false;
+    }
+    if (job.output.empty() && job.partial.empty()) {
+        error = "no output (or partial) to write to";
+        return false;
+    }
+    job.settings.filter = Filter(job.filterType, job.filterRadius);
+    return true;
+}
+
+std::string RenderServer::runJob(const std::string& line) {
+    Job job;
+    std::string error;
+    if (!parseJob(line, job, error)) {
+        return "error " + job.id + " " + error;
+    }
+    
+    const auto start = std::chrono::steady_clock::now();
+    std::shared_ptr<const Scene> scene = scenes.get(job.sceneName);
+    if (!scene) {
+        return "error " + job.id + " unknown scene: " + job.sceneName;
+    }
+    
+    Camera camera = generateCamera(job.settings.width, job.settings.height, job.lookFrom, job.lookAt);
+    const Accumulator accumulator = render(*scene, camera, job.settings, nullptr, &pool);
+    
+    if (!job.output.empty() && !writeRender(job.output, accumulator)) {
+        return "error " + job.id + " could not write " + job.output;
+    }
+    if (!job.partial.empty() && !writeAccumulator(job.partial, accumulator)) {
+        return "error " + job.id + " could not write " + job.partial;
+    }
+    
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return "ok " + job.id + " " + std::to_string(seconds);
+}
+
+void RenderServer::serveLines(const std::function<bool(std::string&)>& readLine,
+                              const std::function<void(const std::string&)>& writeLine) {
+    // guards writeLine and the count of this call's jobs still queued or running, which everything the jobs capture
+    // from here has to outlive
+    std::mutex mutex;
+    std::condition_variable jobDone;
+    int pendingJobs = 0;
+    
+    // each job is a task on the shared pool, whose thread renders tiles alongside whichever workers are free (see
+    // render), so that however many jobs are in flight, only the pool's threads ever render
+    std::string line;
+    while (readLine(line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            pendingJobs++;
+        }
+        pool.submit([this, line, &writeLine, &mutex, &jobDone, &pendingJobs]() {
+            const std::string response = runJob(line);
+            std::lock_guard<std::mutex> lock(mutex);
+            writeLine(response);
+            
+            // notified under the lock, since this call may return (taking the captures with it) once it is released
+            if (--pendingJobs == 0) {
+                jobDone.notify_all();
+            }
+        });
+    }
+    
+    std::unique_lock<std::mutex> lock(mutex);
+    jobDone.wait(lock, [&pendingJobs]() { return pendingJobs == 0; });
+}
+
+void RenderServer::serveStream(std::istream& in, std::ostream& out) {
+    serveLines([&in](std::string& line) { return static_cast<bool>(std::getline(in, line)); },
+               [&out](const std::string& response) { out << response << std::endl; });
+}
+
+bool RenderServer::serveSocket(const std::string& path) {
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(address.sun_path)) {
+        std::cerr << "socket path too long: " << path << std::endl;
+        return false;
+    }
+    path.copy(address.sun_path, path.size());
+    
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str()); // left over from a previous run
+    if (listener < 0 ||
+        bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) < 0 ||
+        listen(listener, SOMAXCONN) < 0) {
+        std::cerr << "could not listen on " << path << std::endl;
+        return false;
+    }
+    
+    // a client hanging up early should only fail the write of its responses, not take the server down
+    std::signal(SIGPIPE, SIG_IGN);
+    
+    while (true) {
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+        
+        std::thread([this, connection]() {
+            std::string buffered;
+            auto readLine = [connection, &buffered](std::string& line) {
+                size_t newline;
+                while ((newline = buffered.find('\n')) == std::string::npos) {
+                    char chunk[4096];
+                    const ssize_t received = read(connection, chunk, sizeof(chunk));
+                    if (received <= 0) {
+                        line = buffered;
+                        buffered.clear();
+                        return !line.empty();
+                    }
+                    buffered.append(chunk, received);
+                }
+                line = buffered.substr(0, newline);
+                buffered.erase(0, newline + 1);
+                return true;
+            };
+            auto writeLine = [connection](const std::string& response) {
+                const std::string message = response + "\n";
+                for (size_t sent = 0; sent < message.size(); ) {
+                    const ssize_t written = write(connection, message.data() + sent, message.size() - sent);
+                    if (written <= 0) {
+                        return;
+                    }
+                    sent += written;
+                }
+            };
+            
+            serveLines(readLine, writeLine);
+            close(connection);
+        }).detach();
+    }
+}
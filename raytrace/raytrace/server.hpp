@@ -0,0 +1,73 @@
+/**
+ * @file server.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef server_hpp
+#define server_hpp
+
+#include "scene.hpp"
+#include "threadpool.hpp"
+
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+/* ***********************************************************************
+ * Render server
+ * -----------------------------------------------------------------------
+ * A long running alternative to starting the binary once per image, for
+ * workflows that fire off many small renders of the same scenes. Jobs come
+ * in one per line as space separated key=value pairs, e.g.
+ *
+ *   id=42 scene=cornell width=256 height=256 samples=16 bounces=5 output=frame.ppm
+ *
+ * where the other keys are integrator, sampler, fast_math and
+ * shading_cache (0 or 1), filter and filter_radius (as with --filter),
+ * tile_size, seed, partial (an accumulator file, as with --partial) and
+ * look_from/look_at (x,y,z camera placement). Every job gets one line back,
+ * "ok <id> <seconds>" once its output is written or "error <id> <reason>".
+ *
+ * Jobs are queued as they arrive as tasks on one shared thread pool, which
+ * also renders their tiles, so the pool's threads are the only ones ever
+ * rendering however many jobs are in flight. Each scene is only built the
+ * first time a job asks for it, so that later jobs skip straight to
+ * rendering.
+ * *********************************************************************** */
+
+// scenes by name, built on first use and then shared (read only) by every job that renders them
+struct SceneCache {
+    std::shared_ptr<const Scene> get(const std::string& name); // nullptr if there is no such scene
+    
+    std::map<std::string, std::shared_ptr<const Scene>> scenes;
+    std::mutex mutex;
+};
+
+struct RenderServer {
+    explicit RenderServer(int numThreads) : pool(numThreads) {}
+    
+    // runs a single job line, returning its response line
+    std::string runJob(const std::string& line);
+    
+    // queues jobs from readLine (which returns false once there are no more) on the pool until it runs dry, then waits
+    // for those jobs to finish. responses go to writeLine in the order the jobs finish
+    void serveLines(const std::function<bool(std::string&)>& readLine,
+                    const std::function<void(const std::string&)>& writeLine);
+    
+    void serveStream(std::istream& in, std::ostream& out);
+    
+    // listens on a unix domain socket at path, serving each connection on its own. only returns if setting up the
+    // socket fails
+    bool serveSocket(const std::string& path);
+    
+    ThreadPool pool;
+    SceneCache scenes;
+};
+
+#endif /* server_hpp */
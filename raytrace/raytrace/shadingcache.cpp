@@ -0,0 +1,193 @@
+/**
+ * @file shadingcache.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "shadingcache.hpp"
+
+#include "camera.hpp"
+#include "render.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// default cells are this fraction of the smallest object's box diagonal, as with the radiance cache
+const float kShadingCellsPerObject = 16;
+
+// camera paths followed by populate, along each axis of the image
+const int kPopulatePathsPerAxis = 32;
+
+// directions each probe draws per strategy, and how many probes a cell takes before it is left alone
+const int kDirectionsPerProbe = 4;
+const uint32_t kMaxProbes = 4;
+
+// random stream populate draws from, apart from any render's
+const uint64_t kPopulateSeed = 0x5eedcace;
+
+ShadingCache::ShadingCache(const Scene& scene, float cellSize) : cellSize(cellSize) {
+    if (this->cellSize <= 0) {
+        float smallestDiagonal = std::numeric_limits<float>::max();
+        for (Geometry* geometry : scene.geometry) {
+            const Bounds bounds = geometry->bounds();
+            smallestDiagonal = std::min(smallestDiagonal, glm::length(bounds.max - bounds.min));
+        }
+        this->cellSize = smallestDiagonal / kShadingCellsPerObject;
+    }
+    inverseCellSize = 1 / this->cellSize;
+    
+    targeted = { false, false };
+    for (Geometry* geometry : scene.geometry) {
+        if (const Lambertian* lambertian = std::get_if<Lambertian>(geometry->material)) {
+            targeted[static_cast<int>(SamplingTarget::Light)] |= lambertian->mixture.light > 0;
+            targeted[static_cast<int>(SamplingTarget::Sphere)] |= lambertian->mixture.sphere > 0;
+        }
+    }
+}
+
+/**
+ * the low 16 bits of the cell's index along each axis (so cells 2^16 apart share a key), and which of 5 bins the
+ * normal falls into along each axis, so that the two sides of a thin object, or walls meeting in a corner, get cells of
+ * their own. the top bit is always set, to keep keys clear of the empty slot marker.
+ *
+ * floors are worked out by truncating (and stepping down below 0) rather than with std::floor, which is a libm call
+ * unless the target has SSE4.1, and this runs on every diffuse bounce. bins never go below 0, so they just truncate
+ *
+ */
+uint64_t ShadingCache::cellKey(const glm::vec3& point, const glm::vec3& normal) const {
+    uint64_t key = uint64_t(1) << 63;
+    for (int axis = 0; axis < 3; axis++) {
+        const float x = point[axis] * inverseCellSize;
+        const int64_t truncated = static_cast<int64_t>(x);
+        const int64_t cell = truncated - (x < truncated);
+        const int64_t bin = static_cast<int64_t>((normal[axis] + 1) * 2);
+        key |= (static_cast<uint64_t>(cell) & 0xffff) << (16 * axis);
+        key |= (static_cast<uint64_t>(bin) & 0x7) << (48 + 3 * axis);
+    }
+    return key;
+}
+
+// Fibonacci hashing: the top bits of the key times 2^64 / golden ratio, which spreads neighbouring cells apart
+size_t slotIndex(uint64_t key, int slotShift) {
+    return static_cast<size_t>((key * 0x9e3779b97f4a7c15) >> slotShift);
+}
+
+void ShadingCache::adapt(const glm::vec3& point, const glm::vec3& normal, SamplingMixture& mixture) const {
+    if (slots.empty()) {
+        return;
+    }
+    const uint64_t key = cellKey(point, normal);
+    const size_t mask = slots.size() - 1;
+    for (size_t i = slotIndex(key, slotShift); slots[i].key != 0; i = (i + 1) & mask) {
+        if (slots[i].key == key) {
+            mixture.light *= slots[i].scale[static_cast<int>(SamplingTarget::Light)];
+            mixture.sphere *= slots[i].scale[static_cast<int>(SamplingTarget::Sphere)];
+            return;
+        }
+    }
+}
+
+/**
+ * each weight is scaled by the square root of the fraction of its directions that reached the target, rather than
+ * the fraction itself: a target that is only partly hidden still carries most of the light that reaches the cell, so
+ * its strategy is worth more than its hit rate alone suggests (and the estimate from a handful of probes is noisy)
+ *
+ */
+void ShadingCache::freeze() {
+    slots.clear();
+    if (cells.empty()) {
+        return;
+    }
+    size_t size = 1;
+    int bits = 0;
+    while (size < 2 * cells.size()) {
+        size *= 2;
+        bits++;
+    }
+    slots.assign(size, Slot { 0, { 1, 1 } });
+    slotShift = 64 - bits;
+    
+    for (const auto& cell : cells) {
+        size_t i = slotIndex(cell.first, slotShift);
+        while (slots[i].key != 0) {
+            i = (i + 1) & (size - 1);
+        }
+        slots[i].key = cell.first;
+        const float draws = static_cast<float>(cell.second.probes * kDirectionsPerProbe);
+        for (int target = 0; target < kNumSamplingTargets; target++) {
+            slots[i].scale[target] = std::sqrt(cell.second.reached[target] / draws);
+        }
+    }
+}
+
+// whether direction from point leaves the surface and first hits an object whose material is a Target
+template <typename Target>
+bool reaches(const Scene& scene, const glm::vec3& point, const glm::vec3& normal, const glm::vec3& direction) {
+    if (glm::dot(direction, normal) <= 0) {
+        return false;
+    }
+    Geometry* closestObject = nullptr;
+    float closestIntersection = std::numeric_limits<float>::max();
+    glm::vec3 closestIntersectionPoint;
+    populateClosestIntersection(scene, Ray(direction, point), closestObject, closestIntersection,
+                                closestIntersectionPoint);
+    return closestObject && std::holds_alternative<Target>(*closestObject->material);
+}
+
+void ShadingCache::probe(const Scene& scene, const glm::vec3& point, const glm::vec3& normal) {
+    Cell& cell = cells.emplace(cellKey(point, normal), Cell { 0, { 0, 0 } }).first->second;
+    if (cell.probes >= kMaxProbes) {
+        return;
+    }
+    cell.probes++;
+    for (int i = 0; i < kDirectionsPerProbe; i++) {
+        if (targeted[static_cast<int>(SamplingTarget::Light)]) {
+            cell.reached[static_cast<int>(SamplingTarget::Light)] +=
+                reaches<Light>(scene, point, normal, sampleLightDirection(point));
+        }
+        if (targeted[static_cast<int>(SamplingTarget::Sphere)]) {
+            cell.reached[static_cast<int>(SamplingTarget::Sphere)] +=
+                reaches<Dielectric>(scene, point, normal, sampleSphereDirection(point));
+        }
+    }
+}
+
+void ShadingCache::populate(const Scene& scene, const Camera& camera, const RenderSettings& settings) {
+    // the paths are sampled as the render's tiles will be, and not adapted by whatever cache the thread last had
+    ThreadSettingsScope threadSettings(settings.fastMath, nullptr);
+    seedRandom(kPopulateSeed);
+    for (int i = 0; i < kPopulatePathsPerAxis * kPopulatePathsPerAxis; i++) {
+        // evenly spread over the image, whatever its resolution
+        const float x = (i % kPopulatePathsPerAxis + 0.5f) * settings.width / kPopulatePathsPerAxis;
+        const float y = (i / kPopulatePathsPerAxis + 0.5f) * settings.height / kPopulatePathsPerAxis;
+        const int col = static_cast<int>(x);
+        const int row = static_cast<int>(y);
+        Ray ray = camera.generateRay(pixelToImage(settings, col, row, glm::vec2(x - col, y - row)));
+        
+        for (int bounce = 0; bounce < settings.bounces; bounce++) {
+            Geometry* closestObject = nullptr;
+            float closestIntersection = std::numeric_limits<float>::max();
+            glm::vec3 closestIntersectionPoint;
+            populateClosestIntersection(scene, ray, closestObject, closestIntersection, closestIntersectionPoint);
+            if (!closestObject) {
+                break;
+            }
+            
+            const glm::vec3 normal = closestObject->normal(closestIntersectionPoint);
+            if (std::holds_alternative<Lambertian>(*closestObject->material)) {
+                probe(scene, closestIntersectionPoint, normal);
+            }
+            const bool inside = glm::dot(ray.direction, normal) > 0;
+            ScatterRecord scattered = scatter(*closestObject->material, ray, closestIntersectionPoint, normal, inside);
+            if (!scattered.didScatter) {
+                break;
+            }
+            ray = scattered.out;
+        }
+    }
+    freeze();
+}
@@ -0,0 +1,118 @@
+/**
+ * @file shadingcache.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef shadingcache_hpp
+#define shadingcache_hpp
+
+#include "material.hpp"
+#include "util.hpp"
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+struct Camera;
+struct RenderSettings;
+struct Scene;
+
+/* ***********************************************************************
+ * Shading cache
+ * -----------------------------------------------------------------------
+ * Lambertian::scatter splits its samples between the light, the glass ball
+ * and the cosine lobe in the same proportions everywhere, even where one of
+ * the targets is hidden (the floor behind the ball, say, or a wall the ball
+ * sits below the horizon of). Samples drawn towards a target that cannot be
+ * reached from there carry no light, but still cost a pdf evaluation for
+ * every sample, and crowd out the cosine lobe.
+ *
+ * The cache is a hash grid over cells of quantized position and normal. For
+ * each cell it holds the fraction of each strategy's directions that
+ * actually reach their target first: for the light, the visible fraction of
+ * its area, for the ball, the visible fraction of the cone it subtends.
+ * Lambertian::scatter scales each strategy's weight down by that fraction
+ * (see freeze) and gives the rest to the cosine lobe, and skips evaluating
+ * the pdfs of strategies left with no weight. Directions are still weighted
+ * by the exact density of the mixture they were drawn from, and the cosine
+ * lobe only ever gains weight, so renders converge to the same image with
+ * or without the cache.
+ *
+ * The cache is filled in before the render, on one thread and from its own
+ * random stream, by following a sparse grid of camera paths and probing the
+ * diffuse cells they pass through. Cells no path reached keep the
+ * unadapted mixture. The probed cells' weights are then frozen into a flat,
+ * open addressed table, since the lookup runs on every diffuse bounce. Two
+ * cells that happen to share a key just share weights, which only costs
+ * some variance: whatever the weights, each is a function of the shading
+ * point alone. Render threads only ever read the table, and render() sets
+ * the cache per tile (as it does fast math) from RenderSettings::shadingCache.
+ * *********************************************************************** */
+
+// the targets Lambertian::scatter importance samples, in the order of Cell::reached
+enum class SamplingTarget {
+    Light,
+    Sphere,
+};
+
+const int kNumSamplingTargets = 2;
+
+struct ShadingCache {
+    /**
+     * cells are cubes of this edge length (or an edge of a sixteenth of the smallest object's box if <= 0). only the
+     * targets some Lambertian material of the scene samples towards are probed, the others' weights being 0 anyway
+     *
+     */
+    ShadingCache(const Scene& scene, float cellSize);
+    
+    // probes the cells camera paths through the image settings describes pass through (with its fast math mode), then
+    // freezes the table. resets the calling thread's random state
+    void populate(const Scene& scene, const Camera& camera, const RenderSettings& settings);
+    
+    // scales back the strategies of mixture that rarely reach their target from point, if its cell was probed
+    void adapt(const glm::vec3& point, const glm::vec3& normal, SamplingMixture& mixture) const;
+    
+    // draws a few directions of each strategy from point, counting how many reach their target
+    void probe(const Scene& scene, const glm::vec3& point, const glm::vec3& normal);
+    
+    // fills in the lookup table from the probed cells
+    void freeze();
+    
+    // never 0, which marks an empty slot
+    uint64_t cellKey(const glm::vec3& point, const glm::vec3& normal) const;
+    
+    struct Cell {
+        uint32_t probes; // how many times probe has drawn directions here
+        std::array<uint32_t, kNumSamplingTargets> reached;
+    };
+    
+    struct Slot {
+        uint64_t key;
+        std::array<float, kNumSamplingTargets> scale; // what adapt multiplies each strategy's weight by
+    };
+    
+    float cellSize;
+    float inverseCellSize;
+    std::array<bool, kNumSamplingTargets> targeted;
+    std::unordered_map<uint64_t, Cell> cells;
+    
+    // power of two sized, at most half full, and probed linearly from the slot the key's hash picks
+    std::vector<Slot> slots;
+    int slotShift = 64;
+};
+
+inline const ShadingCache*& threadShadingCache() {
+    thread_local const ShadingCache* cache = nullptr;
+    return cache;
+}
+
+// the cache Lambertian::scatter adapts its mixture from on the calling thread, or nullptr for none
+inline void setShadingCache(const ShadingCache* cache) {
+    threadShadingCache() = cache;
+}
+
+#endif /* shadingcache_hpp */
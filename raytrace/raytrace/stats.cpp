@@ -0,0 +1,131 @@
+/**
+ * @file stats.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "stats.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <mutex>
+
+const char* const kStatCounterNames[kNumStatCounters] = {
+    "camera_rays",
+    "rays_cast",
+    "sphere_tests",
+    "plane_tests",
+    "box_tests",
+    "triangle_tests",
+    "bvh_nodes_visited",
+    "lambertian_samples",
+    "metal_samples",
+    "dielectric_samples",
+    "light_samples",
+    "firefly_resamples",
+};
+
+const char* const kStatTimerNames[kNumStatTimers] = {
+    "render_tile",
+    "closest_intersection",
+    "sphere_intersect",
+    "plane_intersect",
+    "box_intersect",
+    "mesh_intersect",
+    "lambertian_scatter",
+    "metal_scatter",
+    "dielectric_scatter",
+    "light_scatter",
+    "generate_paths",
+    "extend_paths",
+    "shade_paths",
+};
+
+void Stats::merge(const Stats& other) {
+    for (int i = 0; i < kNumStatCounters; i++) {
+        counters[i] += other.counters[i];
+    }
+    for (int i = 0; i < kNumStatTimers; i++) {
+        timerCalls[i] += other.timerCalls[i];
+        timerNanoseconds[i] += other.timerNanoseconds[i];
+    }
+    for (int i = 0; i <= kMaxStatsBounces; i++) {
+        raysByBouncesLeft[i] += other.raysByBouncesLeft[i];
+    }
+}
+
+std::mutex& exitedThreadsMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+Stats& exitedThreadsStats() {
+    static Stats stats;
+    return stats;
+}
+
+#ifdef RAYTRACE_STATS
+ThreadStats::~ThreadStats() {
+    std::lock_guard<std::mutex> lock(exitedThreadsMutex());
+    exitedThreadsStats().merge(stats);
+}
+#endif
+
+Stats collectStats() {
+    Stats total;
+    {
+        std::lock_guard<std::mutex> lock(exitedThreadsMutex());
+        total = exitedThreadsStats();
+    }
+#ifdef RAYTRACE_STATS
+    total.merge(threadStats());
+#endif
+    return total;
+}
+
+double ratio(uint64_t numerator, uint64_t denominator) {
+    return denominator > 0 ? static_cast<double>(numerator) / denominator : 0.0;
+}
+
+bool writeStatsReport(const std::string& filename, const Stats& stats, int maxBounces) {
+    std::ofstream out(filename);
+    const uint64_t* counters = stats.counters;
+    
+    out << "{\n  \"counters\": {\n";
+    for (int i = 0; i < kNumStatCounters; i++) {
+        out << "    \"" << kStatCounterNames[i] << "\": " << counters[i] << (i + 1 < kNumStatCounters ? ",\n" : "\n");
+    }
+    
+    const uint64_t leafTests = counters[static_cast<int>(StatCounter::SphereTests)] +
+                               counters[static_cast<int>(StatCounter::PlaneTests)] +
+                               counters[static_cast<int>(StatCounter::TriangleTests)];
+    out << "  },\n  \"derived\": {\n"
+        << "    \"primitive_tests_per_ray\": "
+        << ratio(leafTests, counters[static_cast<int>(StatCounter::RaysCast)]) << ",\n"
+        << "    \"rays_per_camera_ray\": "
+        << ratio(counters[static_cast<int>(StatCounter::RaysCast)],
+                 counters[static_cast<int>(StatCounter::CameraRays)]) << ",\n"
+        << "    \"firefly_resamples_per_lambertian_sample\": "
+        << ratio(counters[static_cast<int>(StatCounter::FireflyResamples)],
+                 counters[static_cast<int>(StatCounter::LambertianSamples)]) << "\n";
+    
+    out << "  },\n  \"timers\": {\n";
+    for (int i = 0; i < kNumStatTimers; i++) {
+        out << "    \"" << kStatTimerNames[i] << "\": { \"calls\": " << stats.timerCalls[i]
+            << ", \"seconds\": " << stats.timerNanoseconds[i] * 1e-9
+            << ", \"ns_per_call\": " << ratio(stats.timerNanoseconds[i], stats.timerCalls[i])
+            << (i + 1 < kNumStatTimers ? " },\n" : " }\n");
+    }
+    
+    // entry d is the number of rays cast after d bounces, i.e. how many paths survived that deep. budgets past
+    // kMaxStatsBounces have their shallowest depths lumped into the first entry
+    const int firstDepth = std::max(0, maxBounces - kMaxStatsBounces);
+    out << "  },\n  \"max_bounces\": " << maxBounces << ",\n  \"rays_per_depth\": [";
+    for (int depth = firstDepth; depth <= maxBounces; depth++) {
+        out << (depth > firstDepth ? ", " : "") << stats.raysByBouncesLeft[maxBounces - depth];
+    }
+    out << "]\n}\n";
+    return static_cast<bool>(out);
+}
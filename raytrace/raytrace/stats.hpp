@@ -0,0 +1,152 @@
+/**
+ * @file stats.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef stats_hpp
+#define stats_hpp
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+
+/* ***********************************************************************
+ * Render statistics
+ * -----------------------------------------------------------------------
+ * Counters and timers around the hot paths (closest hit queries, each
+ * primitive's intersect, each material's scatter and the integrator stages)
+ * to see where render time goes. They are only compiled in when
+ * RAYTRACE_STATS is defined (cmake -DRAYTRACE_STATS=ON): otherwise every
+ * STATS_* macro expands to nothing, so regular builds pay nothing for them.
+ *
+ * When enabled, each thread counts into its own thread_local block with
+ * plain increments (no atomics or locks on the hot path), and that block is
+ * folded into a global total when the thread exits. Timers read the steady
+ * clock twice per call, which is a real cost next to a ~10ns primitive test,
+ * so treat their absolute numbers as inclusive upper bounds and compare them
+ * against each other rather than against an uninstrumented build.
+ * *********************************************************************** */
+
+enum class StatCounter {
+    CameraRays,
+    RaysCast,
+    SphereTests,
+    PlaneTests, // including the sides of boxes
+    BoxTests,
+    TriangleTests,
+    BVHNodes, // bounding volume hierarchy nodes visited
+    LambertianSamples,
+    MetalSamples,
+    DielectricSamples,
+    LightSamples,
+    FireflyResamples, // Lambertian samples thrown away for having too small a pdf
+};
+
+const int kNumStatCounters = static_cast<int>(StatCounter::FireflyResamples) + 1;
+
+enum class StatTimer {
+    RenderTile,
+    ClosestIntersection,
+    SphereIntersect,
+    PlaneIntersect,
+    BoxIntersect,
+    MeshIntersect,
+    LambertianScatter,
+    MetalScatter,
+    DielectricScatter,
+    LightScatter,
+    GeneratePaths,
+    ExtendPaths,
+    ShadePaths,
+};
+
+const int kNumStatTimers = static_cast<int>(StatTimer::ShadePaths) + 1;
+
+// rays are binned by how many bounces they had left, since that is all castRay knows; deeper budgets share a bin
+const int kMaxStatsBounces = 1024;
+
+struct Stats {
+    uint64_t counters[kNumStatCounters] = {};
+    uint64_t timerCalls[kNumStatTimers] = {};
+    uint64_t timerNanoseconds[kNumStatTimers] = {};
+    uint64_t raysByBouncesLeft[kMaxStatsBounces + 1] = {};
+    
+    void merge(const Stats& other);
+};
+
+#ifdef RAYTRACE_STATS
+
+const bool kStatsEnabled = true;
+
+// owner of a thread's stats, which hands them over to the global total when the thread exits
+struct ThreadStats {
+    Stats stats;
+    
+    ~ThreadStats();
+};
+
+inline Stats& threadStats() {
+    thread_local ThreadStats threadStats;
+    return threadStats.stats;
+}
+
+struct ScopedStatTimer {
+    const int timer;
+    const std::chrono::steady_clock::time_point start;
+    
+    ScopedStatTimer(StatTimer timer) : timer(static_cast<int>(timer)), start(std::chrono::steady_clock::now()) {}
+    
+    ~ScopedStatTimer() {
+        Stats& stats = threadStats();
+        stats.timerCalls[timer]++;
+        stats.timerNanoseconds[timer] += std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count();
+    }
+};
+
+#define STATS_CONCAT_INNER(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT_INNER(a, b)
+
+#define STATS_ADD(counter, n) (threadStats().counters[static_cast<int>(StatCounter::counter)] += (n))
+#define STATS_COUNT(counter) STATS_ADD(counter, 1)
+#define STATS_TIME(timer) ScopedStatTimer STATS_CONCAT(statsTimer, __LINE__)(StatTimer::timer)
+#define STATS_RAY_BOUNCES_LEFT(bounces) \
+    (threadStats().raysByBouncesLeft[(bounces) < kMaxStatsBounces ? (bounces) : kMaxStatsBounces]++)
+
+// leaf primitive tests made by the calling thread so far, for attributing them to pixels (see RenderProfile)
+inline uint64_t primitiveTests() {
+    const Stats& stats = threadStats();
+    return stats.counters[static_cast<int>(StatCounter::SphereTests)] +
+           stats.counters[static_cast<int>(StatCounter::PlaneTests)] +
+           stats.counters[static_cast<int>(StatCounter::TriangleTests)];
+}
+
+#else
+
+const bool kStatsEnabled = false;
+
+#define STATS_ADD(counter, n) ((void)0)
+#define STATS_COUNT(counter) ((void)0)
+#define STATS_TIME(timer) ((void)0)
+#define STATS_RAY_BOUNCES_LEFT(bounces) ((void)0)
+
+inline uint64_t primitiveTests() {
+    return 0;
+}
+
+#endif
+
+// totals of every thread that has exited plus the calling thread (so call it once the render threads are joined)
+Stats collectStats();
+
+/**
+ * writes the stats as JSON: raw counters, timer calls/seconds, a few derived ratios (primitive tests per ray, firefly
+ * resamples per Lambertian sample) and the number of rays cast at each depth of paths up to maxBounces bounces
+ *
+ */
+bool writeStatsReport(const std::string& filename, const Stats& stats, int maxBounces);
+
+#endif /* stats_hpp */
@@ -0,0 +1,45 @@
+/**
+ * @file threadpool.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef threadpool_hpp
+#define threadpool_hpp
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads running queued tasks in FIFO order. render() normally starts (and joins) its own
+ * threads, which is fine for a single frame; a long running process instead hands every render the same pool so
+ * that concurrent renders share the machine rather than each spawning a thread per core
+ *
+ */
+struct ThreadPool {
+    explicit ThreadPool(int numThreads); // 0 uses every hardware thread
+    ~ThreadPool(); // runs whatever is still queued, then joins the workers
+    
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+    
+    void submit(std::function<void()> task);
+    
+    int size() const {
+        return static_cast<int>(workers.size());
+    }
+    
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable taskAvailable;
+    bool stopping = false;
+};
+
+#endif /* threadpool_hpp */
@@ -9,6 +9,10 @@
 #ifndef util_h
 #define util_h
 
+#include <cstdint>
+#include <memory>
+#include <sstream>
+#include <string>
 #include <vector>
 #include <glm/vec3.hpp> // glm::vec3
 #include <glm/gtx/string_cast.hpp>
@@ -28,4 +32,56 @@ struct Ray {
            const glm::vec3& origin) : direction(direction), origin(origin) {}
 };
 
+/**
+ * Random numbers used while rendering
+ *
+ * glm::linearRand goes through std::rand, which shares (and locks) a single global state, so render threads would
+ * serialize on it and results would depend on thread interleaving. Instead each thread owns a small PCG32 generator
+ * (https://www.pcg-random.org) that the renderer reseeds per tile.
+ *
+ */
+struct RandomState {
+    uint64_t state = 0x853c49e6748fea9bULL;
+    uint64_t inc = 0xda3e39cb94b95bdbULL;
+    
+    uint32_t next() {
+        uint64_t old = state;
+        state = old * 6364136223846793005ULL + inc;
+        uint32_t xorshifted = static_cast<uint32_t>(((old >> 18u) ^ old) >> 27u);
+        uint32_t rot = static_cast<uint32_t>(old >> 59u);
+        return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+    }
+};
+
+inline RandomState& threadRandomState() {
+    thread_local RandomState randomState;
+    return randomState;
+}
+
+inline void seedRandom(uint64_t seed) {
+    RandomState& randomState = threadRandomState();
+    randomState.state = 0;
+    randomState.inc = (seed << 1u) | 1u;
+    randomState.next();
+    randomState.state += 0x853c49e6748fea9bULL ^ seed;
+    randomState.next();
+}
+
+// uniform in [0, 1)
+inline float randomFloat() {
+    return (threadRandomState().next() >> 8) * (1.0f / 16777216.0f);
+}
+
+// uniform in [lo, hi)
+inline float randomFloat(float lo, float hi) {
+    return lo + (hi - lo) * randomFloat();
+}
+
+// parses "x,y,z", as used for vectors in render jobs and animation files
+inline bool parseVec3(const std::string& value, glm::vec3& vector) {
+    char comma1, comma2;
+    std::istringstream stream(value);
+    return (stream >> vector.x >> comma1 >> vector.y >> comma2 >> vector.z) && comma1 == ',' && comma2 == ',';
+}
+
 #endif /* util_h */
@@ -0,0 +1,287 @@
+/**
+ * @file wavefront.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "wavefront.hpp"
+
+#include "material.hpp"
+#include "stats.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <utility>
+
+PathBuffer::PathBuffer(Arena& arena, size_t capacity) : capacity(capacity) {
+    for (float** channel : { &originX, &originY, &originZ,
+                             &directionX, &directionY, &directionZ,
+                             &throughputR, &throughputG, &throughputB,
+                             &offsetX, &offsetY,
+                             &hitDistance, &hitX, &hitY, &hitZ,
+                             &normalX, &normalY, &normalZ }) {
+        *channel = arena.allocateArray<float>(capacity);
+    }
+    pixel = arena.allocateArray<int>(capacity);
+    bounce = arena.allocateArray<int>(capacity);
+    hitObject = arena.allocateArray<Geometry*>(capacity);
+}
+
+// samples of the same pixel are handed out consecutively, so neighbouring slots start out as near-identical rays
+void generatePaths(const Camera& camera,
+                   const RenderSettings& settings,
+                   const Tile& tile,
+                   long& nextSample,
+                   const long numSamples,
+                   PathBuffer& paths,
+                   FilmTile& film) {
+    STATS_TIME(GeneratePaths);
+    int sampleBegin, sampleEnd;
+    shardSampleRange(settings, sampleBegin, sampleEnd);
+    const int samplesPerPixel = sampleEnd - sampleBegin;
+    
+    const int tileWidth = tile.x1 - tile.x0;
+    while (paths.size < paths.capacity && nextSample < numSamples) {
+        const int pixel = static_cast<int>(nextSample / samplesPerPixel);
+        const int sample = sampleBegin + static_cast<int>(nextSample % samplesPerPixel);
+        const int col = tile.x0 + pixel % tileWidth;
+        const int row = tile.y0 + pixel / tileWidth;
+        
+        const size_t i = paths.size++;
+        const glm::vec2 offset = samplePixelOffset(settings, sample);
+        paths.setRay(i, camera.generateRay(pixelToImage(settings, col, row, offset)));
+        paths.setThroughput(i, Color(1, 1, 1));
+        paths.pixel[i] = pixel;
+        paths.offsetX[i] = offset.x;
+        paths.offsetY[i] = offset.y;
+        film.addWeight(col, row, offset);
+        paths.bounce[i] = settings.bounces;
+        nextSample++;
+        STATS_COUNT(CameraRays);
+    }
+}
+
+// same closest-hit rule as populateClosestIntersection. without a BVH the loops are swapped, to test each primitive
+// against every path in turn, and normals are only taken once every object has been tested
+void extendPaths(const Scene& scene, PathBuffer& paths) {
+    STATS_TIME(ExtendPaths);
+    STATS_ADD(RaysCast, paths.size);
+    for (size_t i = 0; i < paths.size; i++) {
+        STATS_RAY_BOUNCES_LEFT(paths.bounce[i]);
+    }
+    std::fill(paths.hitDistance, paths.hitDistance + paths.size, std::numeric_limits<float>::max());
+    std::fill(paths.hitObject, paths.hitObject + paths.size, nullptr);
+    
+    if (!scene.bvh.empty()) {
+        for (size_t i = 0; i < paths.size; i++) {
+            glm::vec3 intersectionPoint;
+            int closest = scene.bvh.intersect(scene.geometry, paths.ray(i), paths.hitDistance[i], intersectionPoint);
+            if (closest >= 0) {
+                Geometry* object = scene.geometry[closest];
+                paths.setHit(i, object, intersectionPoint, object->normal(intersectionPoint));
+            }
+        }
+        return;
+    }
+    
+    for (Geometry* object : scene.geometry) {
+        for (size_t i = 0; i < paths.size; i++) {
+            glm::vec3 intersectionPoint;
+            float intersection = object->intersect(paths.ray(i), intersectionPoint);
+            if (intersection > 0 && intersection < paths.hitDistance[i]) {
+                paths.hitDistance[i] = intersection;
+                paths.hitX[i] = intersectionPoint.x;
+                paths.hitY[i] = intersectionPoint.y;
+                paths.hitZ[i] = intersectionPoint.z;
+                paths.hitObject[i] = object;
+            }
+        }
+    }
+    for (size_t i = 0; i < paths.size; i++) {
+        if (paths.hitObject[i]) {
+            paths.setHit(i, paths.hitObject[i], paths.hitPoint(i), paths.hitObject[i]->normal(paths.hitPoint(i)));
+        }
+    }
+}
+
+// one bin per (material type, direction octant) pair, plus a final bin for paths that escaped the scene
+const int kNumDirectionBins = 8;
+const int kMissBin = kNumMaterialTypes * kNumDirectionBins;
+
+int shadingBin(const PathBuffer& paths, size_t i) {
+    if (paths.hitObject[i] == nullptr) {
+        return kMissBin;
+    }
+    int octant = (paths.directionX[i] < 0) | ((paths.directionY[i] < 0) << 1) | ((paths.directionZ[i] < 0) << 2);
+    return static_cast<int>(materialType(*paths.hitObject[i]->material)) * kNumDirectionBins + octant;
+}
+
+// where shadePaths sorts a batch's paths, sized for a whole batch up front so it can be reused for every batch of a tile
+struct ShadingOrder {
+    int* bins;
+    int* order;
+    std::array<int, kMissBin + 2> binStart;
+    
+    ShadingOrder(Arena& arena, size_t capacity) :
+        bins(arena.allocateArray<int>(capacity)), order(arena.allocateArray<int>(capacity)) {}
+};
+
+// counting sort of the live paths by shading bin into sorted.order, where bin b begins at sorted.binStart[b]
+void sortByShadingBin(const PathBuffer& paths, ShadingOrder& sorted) {
+    int* bins = sorted.bins;
+    std::array<int, kMissBin + 2>& binStart = sorted.binStart;
+    binStart.fill(0);
+    for (size_t i = 0; i < paths.size; i++) {
+        bins[i] = shadingBin(paths, i);
+        binStart[bins[i] + 1]++;
+    }
+    for (int bin = 0; bin <= kMissBin; bin++) {
+        binStart[bin + 1] += binStart[bin];
+    }
+    
+    std::array<int, kMissBin + 1> cursor;
+    std::copy(binStart.begin(), binStart.end() - 1, cursor.begin());
+    for (size_t i = 0; i < paths.size; i++) {
+        sorted.order[cursor[bins[i]]++] = static_cast<int>(i);
+    }
+}
+
+// adds radiance that reached the camera along path i, filtered around the pixel its sample came from
+void addPathRadiance(const PathBuffer& paths, size_t i, const Tile& tile, FilmTile& film, const Color& radiance) {
+    const int tileWidth = tile.x1 - tile.x0;
+    film.addRadiance(tile.x0 + paths.pixel[i] % tileWidth, tile.y0 + paths.pixel[i] / tileWidth,
+                     glm::vec2(paths.offsetX[i], paths.offsetY[i]), radiance);
+}
+
+/**
+ * shading kernel for a run of paths that all hit a material of concrete type MaterialT. the material is resolved
+ * once per kernel at compile time, so the loop body is the same straight-line code for every path in the run
+ *
+ */
+template <typename MaterialT>
+void shadeHits(const PathBuffer& paths,
+               const int* order,
+               int begin,
+               int end,
+               PathBuffer& next,
+               const Tile& tile,
+               FilmTile& film) {
+    for (int k = begin; k < end; k++) {
+        const int i = order[k];
+        const MaterialT& material = std::get<MaterialT>(*paths.hitObject[i]->material);
+        const Ray ray = paths.ray(i);
+        const glm::vec3 point = paths.hitPoint(i);
+        const glm::vec3 normal = paths.hitNormal(i);
+        const bool inside = glm::dot(ray.direction, normal) > 0;
+        const Color throughput = paths.throughput(i);
+        
+        addPathRadiance(paths, i, tile, film, throughput * material.emit(point, normal));
+        
+        ScatterRecord scattered = material.scatter(ray, point, normal, inside);
+        if (!scattered.didScatter || paths.bounce[i] == 0) {
+            continue;
+        }
+        
+        // see castRay: a zero sampling pdf means the material has no MIS weighting
+        Color weight = scattered.color;
+        if (scattered.pdf != 0.0) {
+            weight *= material.scatterPDF(ray, normal, scattered.out.direction) / scattered.pdf;
+        }
+        
+        const size_t j = next.size++;
+        next.setRay(j, scattered.out);
+        next.setThroughput(j, throughput * weight);
+        next.pixel[j] = paths.pixel[i];
+        next.offsetX[j] = paths.offsetX[i];
+        next.offsetY[j] = paths.offsetY[i];
+        next.bounce[j] = paths.bounce[i] - 1;
+    }
+}
+
+void shadePaths(const Scene& scene,
+                const PathBuffer& paths,
+                ShadingOrder& sorted,
+                PathBuffer& next,
+                const Tile& tile,
+                FilmTile& film) {
+    STATS_TIME(ShadePaths);
+    sortByShadingBin(paths, sorted);
+    const int* order = sorted.order;
+    const std::array<int, kMissBin + 2>& binStart = sorted.binStart;
+    
+    for (int type = 0; type < kNumMaterialTypes; type++) {
+        const int begin = binStart[type * kNumDirectionBins];
+        const int end = binStart[(type + 1) * kNumDirectionBins];
+        switch (static_cast<MaterialType>(type)) {
+            case MaterialType::Lambertian:
+                shadeHits<Lambertian>(paths, order, begin, end, next, tile, film);
+                break;
+            case MaterialType::Metal:
+                shadeHits<Metal>(paths, order, begin, end, next, tile, film);
+                break;
+            case MaterialType::Dielectric:
+                shadeHits<Dielectric>(paths, order, begin, end, next, tile, film);
+                break;
+            case MaterialType::Light:
+                shadeHits<Light>(paths, order, begin, end, next, tile, film);
+                break;
+        }
+    }
+    
+    for (int k = binStart[kMissBin]; k < binStart[kMissBin + 1]; k++) {
+        const int i = order[k];
+        addPathRadiance(paths, i, tile, film, paths.throughput(i) * scene.backgroundColor);
+    }
+}
+
+void renderTileWavefront(const Scene& scene,
+                         const Camera& camera,
+                         const RenderSettings& settings,
+                         const Tile& tile,
+                         FilmTile& film,
+                         RenderProfile* profile) {
+    Arena& scratch = scratchArena();
+    int sampleBegin, sampleEnd;
+    shardSampleRange(settings, sampleBegin, sampleEnd);
+    const long numSamples = static_cast<long>(tile.numPixels()) * (sampleEnd - sampleBegin);
+    long nextSample = 0;
+    
+    // the shading stage writes surviving paths (already compacted) into the second buffer, which then swaps in
+    const size_t batchSize = static_cast<size_t>(std::max(1L, std::min<long>(kWavefrontBatchSize, numSamples)));
+    PathBuffer paths(scratch, batchSize);
+    PathBuffer next(scratch, batchSize);
+    ShadingOrder sorted(scratch, batchSize);
+    
+    if (settings.bounces < 0) {
+        nextSample = numSamples;
+    }
+    const int tileWidth = tile.x1 - tile.x0;
+    while (nextSample < numSamples || paths.size > 0) {
+        const auto start = std::chrono::steady_clock::now();
+        const uint64_t tests = primitiveTests();
+        
+        generatePaths(camera, settings, tile, nextSample, numSamples, paths, film);
+        extendPaths(scene, paths);
+        next.size = 0;
+        shadePaths(scene, paths, sorted, next, tile, film);
+        
+        // the batch advanced its paths in lockstep, so each one is charged an equal share of its cost
+        if (profile) {
+            const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            const double secondsShare = seconds / paths.size;
+            const double testsShare = static_cast<double>(primitiveTests() - tests) / paths.size;
+            for (size_t i = 0; i < paths.size; i++) {
+                const int pixel = paths.pixel[i];
+                const int imagePixel = (tile.y0 + pixel / tileWidth) * settings.width + tile.x0 + pixel % tileWidth;
+                profile->pixelSeconds[imagePixel] += secondsShare;
+                profile->pixelTests[imagePixel] += testsShare;
+            }
+        }
+        std::swap(paths, next);
+    }
+    scratch.reset();
+}
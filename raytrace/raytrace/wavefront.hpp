@@ -0,0 +1,115 @@
+/**
+ * @file wavefront.hpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#ifndef wavefront_hpp
+#define wavefront_hpp
+
+#include "arena.hpp"
+#include "render.hpp"
+
+/* ***********************************************************************
+ * Wavefront (stream) path tracing
+ * -----------------------------------------------------------------------
+ * castRay follows one path at a time, bouncing between the intersection code
+ * and whichever material's scatter the path happened to hit. Here, we instead
+ * keep a batch of in-flight paths in structure-of-arrays buffers and push the
+ * whole batch through one stage at a time:
+ *
+ *   generate: refill free slots with camera rays for the tile's remaining samples
+ *   extend:   closest hit and its normal for every path, looping over
+ *             objects on the outside so each object is tested against the
+ *             whole batch in one go
+ *   shade:    bin the hits by material type and direction octant, then run one
+ *             (statically dispatched) kernel per material over its bin
+ *   compact:  surviving paths are written densely into a second buffer, which
+ *             swaps in so later stages only ever see live paths
+ *
+ * There is no separate shadow ray stage, since this integrator never connects
+ * to the light explicitly: light sampling is folded into each material's
+ * scatter mixture. The estimator is therefore exactly the one castRay computes,
+ * just evaluated in a cache-friendlier order.
+ *
+ * All of a tile's buffers come out of the render thread's scratch arena,
+ * which is reset once the tile is done, so after the first few tiles the
+ * loop no longer touches the heap at all.
+ * *********************************************************************** */
+
+// number of paths in flight per tile
+const int kWavefrontBatchSize = 4096;
+
+struct PathBuffer {
+    float *originX, *originY, *originZ;
+    float *directionX, *directionY, *directionZ;
+    float *throughputR, *throughputG, *throughputB;
+    int* pixel; // index into the tile
+    float *offsetX, *offsetY; // where in its pixel the path's camera sample landed, for the film's filter
+    int* bounce; // remaining bounces, negative once the path has terminated
+    
+    // populated by the extension stage
+    float* hitDistance;
+    float *hitX, *hitY, *hitZ;
+    float *normalX, *normalY, *normalZ; // taken as soon as the hit is found, while a mesh still has its triangle
+    Geometry** hitObject;
+    
+    size_t size = 0;
+    size_t capacity;
+    
+    // the channels are allocated from arena, and so are only valid until it is reset
+    PathBuffer(Arena& arena, size_t capacity);
+    
+    Ray ray(size_t i) const {
+        return Ray(glm::vec3(directionX[i], directionY[i], directionZ[i]),
+                   glm::vec3(originX[i], originY[i], originZ[i]));
+    }
+    
+    void setRay(size_t i, const Ray& ray) {
+        originX[i] = ray.origin.x;
+        originY[i] = ray.origin.y;
+        originZ[i] = ray.origin.z;
+        directionX[i] = ray.direction.x;
+        directionY[i] = ray.direction.y;
+        directionZ[i] = ray.direction.z;
+    }
+    
+    Color throughput(size_t i) const {
+        return Color(throughputR[i], throughputG[i], throughputB[i]);
+    }
+    
+    void setThroughput(size_t i, const Color& throughput) {
+        throughputR[i] = throughput.x;
+        throughputG[i] = throughput.y;
+        throughputB[i] = throughput.z;
+    }
+    
+    glm::vec3 hitPoint(size_t i) const {
+        return glm::vec3(hitX[i], hitY[i], hitZ[i]);
+    }
+    
+    glm::vec3 hitNormal(size_t i) const {
+        return glm::vec3(normalX[i], normalY[i], normalZ[i]);
+    }
+    
+    void setHit(size_t i, Geometry* object, const glm::vec3& point, const glm::vec3& normal) {
+        hitObject[i] = object;
+        hitX[i] = point.x;
+        hitY[i] = point.y;
+        hitZ[i] = point.z;
+        normalX[i] = normal.x;
+        normalY[i] = normal.y;
+        normalZ[i] = normal.z;
+    }
+};
+
+void renderTileWavefront(const Scene& scene,
+                         const Camera& camera,
+                         const RenderSettings& settings,
+                         const Tile& tile,
+                         FilmTile& film,
+                         RenderProfile* profile);
+
+#endif /* wavefront_hpp */
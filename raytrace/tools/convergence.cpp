@@ -0,0 +1,266 @@
+/**
+ * @file convergence.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "camera.hpp"
+#include "image.hpp"
+#include "material.hpp"
+#include "render.hpp"
+#include "scene.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#include <gflags/gflags.h>
+
+/**
+ * Equal-time convergence harness
+ *
+ * Comparing sampling strategies at a fixed spp hides what each sample costs. Instead, this renders a high spp
+ * reference once and then gives every configuration (integrator x sampler x fast math x Lambertian sampling mixture
+ * x shading cache) the same wall clock budgets. At each budget the running estimate is compared against the
+ * reference, and the efficiency 1 / (MSE * time) says how cheaply a configuration buys a given error: doubling it
+ * halves the time to any target error. Since the estimators are unbiased, MSE against a converged reference stands in
+ * for variance.
+ *
+ */
+
+DEFINE_string(scene, "cornell", "Scene to render: cornell or balls");
+DEFINE_int32(width, 128, "Width of rendering");
+DEFINE_int32(height, 128, "Height of rendering");
+DEFINE_int32(bounces, 5, "Depth of bounces");
+DEFINE_int32(threads, 0, "Number of render threads (0 uses all hardware threads)");
+DEFINE_string(reference, "", "PFM file holding the reference; rendered (and saved here) if it does not exist yet");
+DEFINE_int32(reference_samples, 2048, "Samples per pixel of the reference render");
+DEFINE_string(budgets, "1,2,4,8", "Comma separated wall clock checkpoints in seconds");
+DEFINE_int32(pass_samples, 16, "Samples per pixel of each progressive pass (a square keeps stratification whole)");
+DEFINE_string(integrators, "recursive,wavefront", "Comma separated integrators to compare");
+DEFINE_string(samplers, "random,stratified", "Comma separated samplers to compare");
+DEFINE_string(fast_math, "0", "Comma separated fast math settings to compare (0 exact, 1 fast)");
+DEFINE_string(light_alphas, "0,0.25,0.5", "Comma separated fractions of Lambertian samples drawn towards the light");
+DEFINE_string(sphere_alphas, "0", "Comma separated fractions of Lambertian samples drawn towards the glass ball");
+DEFINE_string(shading_cache, "0", "Comma separated shading cache settings to compare (0 off, 1 on)");
+DEFINE_string(csv, "", "Optionally also write the table to this file as CSV");
+
+struct Configuration {
+    std::string integratorName;
+    std::string samplerName;
+    RenderSettings settings;
+    SamplingMixture mixture;
+};
+
+struct Checkpoint {
+    double seconds;
+    int samples;
+    double rmse;
+    double relMSE;
+    double efficiency;
+};
+
+std::vector<std::string> splitList(const std::string& list) {
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+// mean squared error per channel, and the same relative to the reference (with a small epsilon so black pixels
+// do not dominate), between the estimate sum / samples and the reference
+void computeError(const std::vector<Color>& sum,
+                  int samples,
+                  const std::vector<Color>& reference,
+                  double& mse,
+                  double& relMSE) {
+    const double kRelativeEpsilon = 1e-2;
+    mse = 0.0;
+    relMSE = 0.0;
+    for (size_t i = 0; i < reference.size(); i++) {
+        const Color estimate = sum[i] / static_cast<float>(samples);
+        for (int channel = 0; channel < 3; channel++) {
+            const double error = estimate[channel] - reference[i][channel];
+            mse += error * error;
+            relMSE += error * error / (reference[i][channel] * reference[i][channel] + kRelativeEpsilon);
+        }
+    }
+    mse /= 3.0 * reference.size();
+    relMSE /= 3.0 * reference.size();
+}
+
+/**
+ * runs progressive passes of the configuration, recording a checkpoint each time the elapsed render time crosses
+ * the next budget. each pass gets its own seed, so the passes are independent and just average together. the scene's
+ * Lambertian materials are switched over to the configuration's sampling mixture in place
+ *
+ */
+std::vector<Checkpoint> runConfiguration(Scene& scene,
+                                         const Camera& camera,
+                                         const Configuration& configuration,
+                                         const std::vector<double>& budgets,
+                                         const std::vector<Color>& reference) {
+    setSamplingMixture(scene, configuration.mixture);
+    
+    std::vector<Color> sum(reference.size(), Color(0, 0, 0));
+    std::vector<Checkpoint> checkpoints;
+    RenderSettings settings = configuration.settings;
+    int samples = 0;
+    double seconds = 0.0;
+    
+    for (const double budget : budgets) {
+        while (seconds < budget) {
+            settings.seed++; // seed 0 is left to the reference
+            auto start = std::chrono::steady_clock::now();
+            std::vector<Color> pass = render(scene, camera, settings).sum;
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            
+            for (size_t i = 0; i < sum.size(); i++) {
+                sum[i] += pass[i];
+            }
+            samples += settings.samples;
+        }
+        
+        Checkpoint checkpoint;
+        double mse;
+        computeError(sum, samples, reference, mse, checkpoint.relMSE);
+        checkpoint.seconds = seconds;
+        checkpoint.samples = samples;
+        checkpoint.rmse = std::sqrt(mse);
+        checkpoint.efficiency = 1.0 / (mse * seconds);
+        checkpoints.push_back(checkpoint);
+    }
+    return checkpoints;
+}
+
+int main(int argc, char *argv[]) {
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    
+    Scene scene;
+    if (!generateScene(FLAGS_scene, scene)) {
+        std::cerr << "unknown scene: " << FLAGS_scene << std::endl;
+        return 1;
+    }
+    Camera camera = generateCamera(FLAGS_width, FLAGS_height);
+    
+    RenderSettings baseSettings;
+    baseSettings.width = FLAGS_width;
+    baseSettings.height = FLAGS_height;
+    baseSettings.bounces = FLAGS_bounces;
+    baseSettings.threads = FLAGS_threads;
+    
+    std::vector<double> budgets;
+    for (const std::string& budget : splitList(FLAGS_budgets)) {
+        budgets.push_back(std::stod(budget));
+    }
+    std::sort(budgets.begin(), budgets.end());
+    
+    std::vector<Configuration> configurations;
+    for (const std::string& integratorName : splitList(FLAGS_integrators)) {
+        for (const std::string& samplerName : splitList(FLAGS_samplers)) {
+            for (const std::string& fastMath : splitList(FLAGS_fast_math)) {
+                for (const std::string& lightAlpha : splitList(FLAGS_light_alphas)) {
+                    for (const std::string& sphereAlpha : splitList(FLAGS_sphere_alphas)) {
+                        for (const std::string& shadingCache : splitList(FLAGS_shading_cache)) {
+                            Configuration configuration;
+                            configuration.integratorName = integratorName;
+                            configuration.samplerName = samplerName;
+                            configuration.settings = baseSettings;
+                            configuration.settings.samples = FLAGS_pass_samples;
+                            configuration.settings.fastMath = fastMath != "0";
+                            configuration.settings.shadingCache = shadingCache != "0";
+                            configuration.mixture.light = std::stof(lightAlpha);
+                            configuration.mixture.sphere = std::stof(sphereAlpha);
+                            if (!parseIntegrator(integratorName, configuration.settings.integrator)) {
+                                std::cerr << "unknown integrator: " << integratorName << std::endl;
+                                return 1;
+                            }
+                            if (!parseSampler(samplerName, configuration.settings.sampler)) {
+                                std::cerr << "unknown sampler: " << samplerName << std::endl;
+                                return 1;
+                            }
+                            if (configuration.mixture.light + configuration.mixture.sphere > 1) {
+                                std::cerr << "light and sphere alphas sum past 1: " << lightAlpha << ", "
+                                          << sphereAlpha << std::endl;
+                                return 1;
+                            }
+                            configurations.push_back(configuration);
+                        }
+                    }
+                }
+            }
+        }
+    }
+    
+    // the reference uses the default configuration: every configuration should converge to the same image anyway
+    std::vector<Color> reference;
+    int referenceWidth = 0, referenceHeight = 0;
+    if (!FLAGS_reference.empty() && readPFM(FLAGS_reference, referenceWidth, referenceHeight, reference)) {
+        if (referenceWidth != FLAGS_width || referenceHeight != FLAGS_height) {
+            std::cerr << "reference " << FLAGS_reference << " is " << referenceWidth << "x" << referenceHeight
+                      << ", not " << FLAGS_width << "x" << FLAGS_height << std::endl;
+            return 1;
+        }
+        std::cerr << "loaded reference from " << FLAGS_reference << std::endl;
+    } else {
+        RenderSettings referenceSettings = baseSettings;
+        referenceSettings.samples = FLAGS_reference_samples;
+        std::cerr << "rendering " << FLAGS_reference_samples << " spp reference..." << std::endl;
+        reference = render(scene, camera, referenceSettings).sum;
+        for (Color& color : reference) {
+            color /= static_cast<float>(FLAGS_reference_samples);
+        }
+        if (!FLAGS_reference.empty() && !writePFM(FLAGS_reference, FLAGS_width, FLAGS_height, reference)) {
+            std::cerr << "could not write reference to " << FLAGS_reference << std::endl;
+        }
+    }
+    
+    std::ofstream csv;
+    if (!FLAGS_csv.empty()) {
+        csv.open(FLAGS_csv);
+        csv << "integrator,sampler,fast_math,light_alpha,sphere_alpha,shading_cache,budget,seconds,spp,rmse,rel_mse,"
+            << "efficiency\n";
+    }
+    
+    std::cout << std::left << std::setw(11) << "integrator" << std::setw(11) << "sampler" << std::setw(5) << "fast"
+              << std::setw(7) << "light" << std::setw(7) << "sphere" << std::setw(6) << "cache" << std::right
+              << std::setw(8) << "budget" << std::setw(9) << "seconds" << std::setw(7) << "spp"
+              << std::setw(12) << "rmse" << std::setw(12) << "relMSE" << std::setw(13) << "efficiency" << std::endl;
+    for (const Configuration& configuration : configurations) {
+        std::vector<Checkpoint> checkpoints = runConfiguration(scene, camera, configuration, budgets, reference);
+        for (size_t i = 0; i < checkpoints.size(); i++) {
+            const Checkpoint& checkpoint = checkpoints[i];
+            std::cout << std::left << std::setw(11) << configuration.integratorName
+                      << std::setw(11) << configuration.samplerName << std::setw(5) << configuration.settings.fastMath
+                      << std::setw(7) << configuration.mixture.light << std::setw(7) << configuration.mixture.sphere
+                      << std::setw(6) << configuration.settings.shadingCache << std::right << std::fixed
+                      << std::setw(8) << std::setprecision(1) << budgets[i]
+                      << std::setw(9) << std::setprecision(2) << checkpoint.seconds
+                      << std::setw(7) << checkpoint.samples
+                      << std::scientific << std::setprecision(3)
+                      << std::setw(12) << checkpoint.rmse << std::setw(12) << checkpoint.relMSE
+                      << std::setw(13) << checkpoint.efficiency << std::defaultfloat << std::endl;
+            if (csv.is_open()) {
+                csv << configuration.integratorName << ',' << configuration.samplerName << ','
+                    << configuration.settings.fastMath << ','
+                    << configuration.mixture.light << ',' << configuration.mixture.sphere << ','
+                    << configuration.settings.shadingCache << ','
+                    << budgets[i] << ',' << checkpoint.seconds << ',' << checkpoint.samples << ','
+                    << checkpoint.rmse << ',' << checkpoint.relMSE << ',' << checkpoint.efficiency << '\n';
+            }
+        }
+    }
+    
+    return 0;
+}
@@ -0,0 +1,72 @@
+/**
+ * @file merge.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "image.hpp"
+
+#include <iostream>
+
+#include <gflags/gflags.h>
+
+/**
+ * Merges the partial renders written by raytrace --shard=i/N --partial=... into the final frame. each pixel ends up
+ * as its total sample sum over the total sample count, so shards of either mode (and even separate runs with different
+ * seeds) combine correctly, weighted by how many samples each contributed
+ *
+ *   raytrace_merge --filename frame.ppm shard0.acc shard1.acc ...
+ *
+ */
+
+DEFINE_string(filename, "", "Output file for the merged rendering");
+DEFINE_string(partial, "", "Optionally also write the merged sums and counts to this file, to merge further later");
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("raytrace_merge --filename frame.ppm shard0.acc shard1.acc ...");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    if (argc < 2 || (FLAGS_filename.empty() && FLAGS_partial.empty())) {
+        std::cerr << "usage: raytrace_merge --filename frame.ppm shard0.acc shard1.acc ..." << std::endl;
+        return 1;
+    }
+    
+    Accumulator merged;
+    for (int i = 1; i < argc; i++) {
+        Accumulator partial;
+        if (!readAccumulator(argv[i], partial)) {
+            std::cerr << "could not read partial render " << argv[i] << std::endl;
+            return 1;
+        }
+        if (i == 1) {
+            merged = partial;
+            continue;
+        }
+        if (partial.width != merged.width || partial.height != merged.height) {
+            std::cerr << argv[i] << " is " << partial.width << "x" << partial.height << ", not "
+                      << merged.width << "x" << merged.height << std::endl;
+            return 1;
+        }
+        merged.merge(partial);
+    }
+    
+    size_t missing = 0;
+    for (const uint32_t samples : merged.samples) {
+        missing += samples == 0;
+    }
+    if (missing > 0) {
+        std::cerr << "warning: " << missing << " pixels have no samples (is a shard missing?)" << std::endl;
+    }
+    
+    if (!FLAGS_partial.empty() && !writeAccumulator(FLAGS_partial, merged)) {
+        std::cerr << "could not write merged partial render to " << FLAGS_partial << std::endl;
+        return 1;
+    }
+    if (!FLAGS_filename.empty() && !writeRender(FLAGS_filename, merged)) {
+        std::cerr << "could not write render to " << FLAGS_filename << std::endl;
+        return 1;
+    }
+    
+    return 0;
+}
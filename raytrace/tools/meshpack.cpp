@@ -0,0 +1,102 @@
+/**
+ * @file meshpack.cpp
+ *
+ * @author Yash Patel
+ * Contact: yppatel@umich.edu
+ *
+ */
+
+#include "mesh.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+#include <gflags/gflags.h>
+
+/**
+ * Packs a Wavefront OBJ mesh into the binary format the renderer maps directly (see mesh.hpp), so that all of the
+ * parsing and BVH building happens once here rather than every time a scene is loaded. only positions and faces are
+ * read (polygons are split into fans of triangles), and the mesh can be scaled and moved into scene coordinates on
+ * the way
+ *
+ *   raytrace_meshpack --input bunny.obj --output bunny.rtmesh --scale 2000 --translate 0,-500,-1500
+ *
+ */
+
+DEFINE_string(input, "", "Wavefront OBJ file to pack");
+DEFINE_string(output, "", "Packed mesh file to write");
+DEFINE_double(scale, 1.0, "Scale applied to every vertex (before --translate)");
+DEFINE_string(translate, "0,0,0", "Offset x,y,z added to every vertex");
+
+// the vertex an OBJ face corner ("v", "v/vt", "v//vn" or "v/vt/vn") refers to, as a 0-based index
+bool parseCorner(const std::string& corner, size_t numVertices, uint32_t& index) {
+    long reference;
+    try {
+        reference = std::stol(corner.substr(0, corner.find('/')));
+    } catch (const std::exception&) {
+        return false;
+    }
+    // negative references count back from the most recent vertex
+    const long resolved = reference < 0 ? static_cast<long>(numVertices) + reference : reference - 1;
+    if (resolved < 0 || resolved >= static_cast<long>(numVertices)) {
+        return false;
+    }
+    index = static_cast<uint32_t>(resolved);
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    gflags::SetUsageMessage("raytrace_meshpack --input mesh.obj --output mesh.rtmesh");
+    gflags::ParseCommandLineFlags(&argc, &argv, true);
+    glm::vec3 translation;
+    if (FLAGS_input.empty() || FLAGS_output.empty() || !parseVec3(FLAGS_translate, translation)) {
+        std::cerr << "usage: raytrace_meshpack --input mesh.obj --output mesh.rtmesh [--scale s] [--translate x,y,z]"
+                  << std::endl;
+        return 1;
+    }
+
+    std::ifstream in(FLAGS_input);
+    if (!in) {
+        std::cerr << "could not read " << FLAGS_input << std::endl;
+        return 1;
+    }
+
+    std::vector<glm::vec3> positions;
+    std::vector<MeshTriangle> triangles;
+    std::string line;
+    for (int lineNumber = 1; std::getline(in, line); lineNumber++) {
+        std::istringstream tokens(line);
+        std::string kind;
+        tokens >> kind;
+        if (kind == "v") {
+            glm::vec3 position;
+            if (!(tokens >> position.x >> position.y >> position.z)) {
+                std::cerr << FLAGS_input << ":" << lineNumber << ": bad vertex" << std::endl;
+                return 1;
+            }
+            positions.push_back(position * static_cast<float>(FLAGS_scale) + translation);
+        } else if (kind == "f") {
+            std::vector<uint32_t> corners;
+            std::string corner;
+            while (tokens >> corner) {
+                uint32_t index;
+                if (!parseCorner(corner, positions.size(), index)) {
+                    std::cerr << FLAGS_input << ":" << lineNumber << ": bad face corner " << corner << std::endl;
+                    return 1;
+                }
+                corners.push_back(index);
+            }
+            for (size_t i = 2; i < corners.size(); i++) {
+                triangles.push_back({ { corners[0], corners[i - 1], corners[i] } });
+            }
+        }
+    }
+
+    if (!writeMesh(FLAGS_output, positions, triangles)) {
+        std::cerr << "could not write " << FLAGS_output << std::endl;
+        return 1;
+    }
+    std::cerr << "packed " << triangles.size() << " triangles over " << positions.size() << " vertices" << std::endl;
+    return 0;
+}